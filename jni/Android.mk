@@ -13,14 +13,14 @@ LOCAL_LDFLAGS += -fPIC
 LOCAL_LDLIBS := -llog
 LOCAL_ARM_NEON := true
 LOCAL_MODULE    := displayport_osd_shim
-LOCAL_SRC_FILES := displayport_osd_shim.c osd_dji_overlay_udp.c msp/msp_displayport.c msp/msp.c net/network.c util/fs_util.c hw/dji_radio_shm.c hw/dji_display.c hw/dji_services.c json/osd_config.c json/parson.c
+LOCAL_SRC_FILES := displayport_osd_shim.c osd_dji_overlay_udp.c msp/msp_displayport.c msp/msp_displayport_delta.c msp/msp.c net/msp_link.c net/msp_link_displayport.c net/network.c font/font_container.c font/font_registry.c font/glyph_spans.c util/blit.c util/osd_grid.c util/rle.c util/fs_util.c hw/dji_radio_shm.c hw/dji_display.c hw/dji_services.c json/osd_config.c json/parson.c
 LOCAL_SHARED_LIBRARIES := duml_hal
 
 include $(BUILD_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 
-LOCAL_SRC_FILES:= msp_displayport_mux.c net/serial.c net/network.c msp/msp.c util/fs_util.c hw/dji_radio_shm.c json/osd_config.c json/parson.c
+LOCAL_SRC_FILES:= msp_displayport_mux.c net/serial.c net/msp_link.c net/network.c msp/msp.c msp/msp_displayport.c msp/msp_displayport_delta.c util/fs_util.c util/rle.c hw/dji_radio_shm.c json/osd_config.c json/parson.c
 LOCAL_MODULE := msp_displayport_mux
 
 include $(BUILD_EXECUTABLE)
@@ -0,0 +1,167 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+// Host benchmark: full redraws of the SD, HD and full-screen layouts split into 1 to MAX_BANDS horizontal bands,
+// with the render thread drawing band 0 and a worker pool the rest, the way draw_bands in osd_dji_overlay_udp.c does.
+// The overlay needs the DJI HAL to build, so its band loop is mirrored here over a whole screen of glyphs.
+
+#define WIDTH 1440
+#define HEIGHT 810
+#define BYTES_PER_PIXEL 4
+#define MAX_BANDS 4
+
+typedef struct layout_s {
+    const char *name;
+    uint8_t char_width;
+    uint8_t char_height;
+    uint8_t font_width;
+    uint8_t font_height;
+    uint16_t x_offset;
+    uint16_t y_offset;
+} layout_t;
+
+// same geometry as sd_display_info, hd_display_info and full_display_info
+static const layout_t layouts[] = {
+    { "SD", 31, 15, 36, 54, 180, 0 },
+    { "HD", 50, 18, 24, 36, 120, 80 },
+    { "full", 60, 22, 24, 36, 0, 9 },
+};
+
+static const layout_t *layout;
+static uint8_t *fb;
+static uint8_t *font;
+static uint8_t band_count;
+
+static pthread_t band_workers[MAX_BANDS - 1];
+static uint8_t band_workers_quit = 0;
+static uint32_t band_generation = 0;
+static uint8_t bands_remaining = 0;
+static pthread_mutex_t band_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done_cond = PTHREAD_COND_INITIALIZER;
+
+static void draw_band(uint8_t band) {
+    uint32_t top = band * HEIGHT / band_count;
+    uint32_t bottom = (band + 1) * HEIGHT / band_count;
+    memset(fb + top * WIDTH * BYTES_PER_PIXEL, 0xFF, (bottom - top) * WIDTH * BYTES_PER_PIXEL);
+    uint32_t glyph_size = layout->font_width * layout->font_height * BYTES_PER_PIXEL;
+    for (uint32_t y = 0; y < layout->char_height; y++) {
+        uint32_t pixel_y = y * layout->font_height + layout->y_offset;
+        if (bottom <= pixel_y || top >= pixel_y + layout->font_height) {
+            continue;
+        }
+        uint32_t first_row = top > pixel_y ? top - pixel_y : 0;
+        uint32_t last_row = bottom < pixel_y + layout->font_height ? bottom - pixel_y : layout->font_height;
+        for (uint32_t x = 0; x < layout->char_width; x++) {
+            const uint8_t *source = font + ((x + y * layout->char_width) & 0xFF) * glyph_size + first_row * layout->font_width * BYTES_PER_PIXEL;
+            uint8_t *target = fb + ((pixel_y + first_row) * WIDTH + x * layout->font_width + layout->x_offset) * BYTES_PER_PIXEL;
+            for (uint32_t gy = first_row; gy < last_row; gy++) {
+                memcpy(target, source, layout->font_width * BYTES_PER_PIXEL);
+                source += layout->font_width * BYTES_PER_PIXEL;
+                target += WIDTH * BYTES_PER_PIXEL;
+            }
+        }
+    }
+}
+
+static void *band_worker(void *arg) {
+    uint8_t band = (uint8_t)(uintptr_t)arg;
+    uint32_t generation = 0;
+    pthread_mutex_lock(&band_mutex);
+    while (1) {
+        while (band_generation == generation && !band_workers_quit) {
+            pthread_cond_wait(&band_start_cond, &band_mutex);
+        }
+        if (band_workers_quit) {
+            break;
+        }
+        generation = band_generation;
+        pthread_mutex_unlock(&band_mutex);
+        draw_band(band);
+        pthread_mutex_lock(&band_mutex);
+        if (--bands_remaining == 0) {
+            pthread_cond_signal(&band_done_cond);
+        }
+    }
+    pthread_mutex_unlock(&band_mutex);
+    return NULL;
+}
+
+static void start_band_workers(uint8_t count) {
+    band_count = count;
+    band_workers_quit = 0;
+    band_generation = 0;
+    for (uint8_t i = 0; i < band_count - 1; i++) {
+        pthread_create(&band_workers[i], NULL, &band_worker, (void *)(uintptr_t)(i + 1));
+    }
+}
+
+static void stop_band_workers() {
+    pthread_mutex_lock(&band_mutex);
+    band_workers_quit = 1;
+    pthread_cond_broadcast(&band_start_cond);
+    pthread_mutex_unlock(&band_mutex);
+    for (uint8_t i = 0; i < band_count - 1; i++) {
+        pthread_join(band_workers[i], NULL);
+    }
+}
+
+static void draw_bands() {
+    if (band_count > 1) {
+        pthread_mutex_lock(&band_mutex);
+        bands_remaining = band_count - 1;
+        band_generation++;
+        pthread_cond_broadcast(&band_start_cond);
+        pthread_mutex_unlock(&band_mutex);
+    }
+    draw_band(0);
+    if (band_count > 1) {
+        pthread_mutex_lock(&band_mutex);
+        while (bands_remaining > 0) {
+            pthread_cond_wait(&band_done_cond, &band_mutex);
+        }
+        pthread_mutex_unlock(&band_mutex);
+    }
+}
+
+int main() {
+    size_t font_size = 36 * 54 * BYTES_PER_PIXEL * 256;
+    font = malloc(font_size);
+    for (size_t i = 0; i < font_size; i++) {
+        font[i] = rand();
+    }
+    fb = malloc(WIDTH * HEIGHT * BYTES_PER_PIXEL);
+    uint8_t *reference = malloc(WIDTH * HEIGHT * BYTES_PER_PIXEL);
+
+    printf("%ld cores online, bands past that share a core and only add wakeups\n", sysconf(_SC_NPROCESSORS_ONLN));
+    for (uint8_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        layout = &layouts[l];
+        double one_band_ns = 0;
+        for (uint8_t count = 1; count <= MAX_BANDS; count++) {
+            start_band_workers(count);
+            draw_bands();
+            if (count == 1) {
+                memcpy(reference, fb, WIDTH * HEIGHT * BYTES_PER_PIXEL);
+            } else if (memcmp(reference, fb, WIDTH * HEIGHT * BYTES_PER_PIXEL) != 0) {
+                printf("%s drawn in %u bands differs from one band\n", layout->name, count);
+                return 1;
+            }
+            double ns;
+            BENCH_NS_PER_ITERATION(ns, 100, draw_bands());
+            stop_band_workers();
+            if (count == 1) {
+                one_band_ns = ns;
+            }
+            printf("%-4s %2ux%-2u %u band%s %8.1f us/redraw (%.2fx)\n", layout->name, layout->char_width, layout->char_height,
+                count, count == 1 ? " " : "s", ns / 1000, one_band_ns / ns);
+        }
+    }
+    free(font);
+    free(fb);
+    free(reference);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../util/time_util.h"
+
+// Shared bits for the host benchmarks: run a body for a number of iterations and report the time each took.
+// Build with make -f Makefile.unix <name>, the numbers are only comparable between runs on the same machine.
+
+static inline int64_t bench_now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+
+// best of BENCH_RUNS, so a context switch in one run doesn't skew the result
+#define BENCH_RUNS 5
+
+#define BENCH_NS_PER_ITERATION(result, iterations, body) do { \
+    double best_ns = 0; \
+    for (int bench_run = 0; bench_run < BENCH_RUNS; bench_run++) { \
+        int64_t bench_start = bench_now_ns(); \
+        for (uint32_t bench_i = 0; bench_i < (iterations); bench_i++) { \
+            body; \
+        } \
+        double ns = (double)(bench_now_ns() - bench_start) / (iterations); \
+        if (bench_run == 0 || ns < best_ns) { \
+            best_ns = ns; \
+        } \
+    } \
+    (result) = best_ns; \
+} while (0)
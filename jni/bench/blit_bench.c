@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../util/blit.h"
+
+// Host benchmark: draw a screen of HD glyphs with the per-pixel loop draw_character_map used to have,
+// and a row at a time through blit_rgba_to_dji, which takes the NEON path when built for ARM.
+
+#define WIDTH 1440
+#define HEIGHT 810
+#define BYTES_PER_PIXEL 4
+#define GLYPH_WIDTH 24
+#define GLYPH_HEIGHT 36
+#define GRID_WIDTH 50
+#define GRID_HEIGHT 18
+#define X_OFFSET 120
+#define Y_OFFSET 80
+
+static void draw_glyph_per_pixel(uint8_t *fb, const uint8_t *font, uint32_t x, uint32_t y, uint8_t c) {
+    uint32_t font_offset = GLYPH_WIDTH * GLYPH_HEIGHT * BYTES_PER_PIXEL * c;
+    uint32_t target_offset = (x * GLYPH_WIDTH + X_OFFSET) * BYTES_PER_PIXEL + (y * GLYPH_HEIGHT + Y_OFFSET) * WIDTH * BYTES_PER_PIXEL;
+    for (uint8_t gy = 0; gy < GLYPH_HEIGHT; gy++) {
+        for (uint8_t gx = 0; gx < GLYPH_WIDTH; gx++) {
+            fb[target_offset] = font[font_offset + 2];
+            fb[target_offset + 1] = font[font_offset + 1];
+            fb[target_offset + 2] = font[font_offset];
+            fb[target_offset + 3] = ~font[font_offset + 3];
+            font_offset += BYTES_PER_PIXEL;
+            target_offset += BYTES_PER_PIXEL;
+        }
+        target_offset += (WIDTH - GLYPH_WIDTH) * BYTES_PER_PIXEL;
+    }
+}
+
+static void draw_glyph_rows(uint8_t *fb, const uint8_t *font, uint32_t x, uint32_t y, uint8_t c) {
+    const uint8_t *source = font + GLYPH_WIDTH * GLYPH_HEIGHT * BYTES_PER_PIXEL * c;
+    uint8_t *target = fb + (x * GLYPH_WIDTH + X_OFFSET) * BYTES_PER_PIXEL + (y * GLYPH_HEIGHT + Y_OFFSET) * WIDTH * BYTES_PER_PIXEL;
+    for (uint8_t gy = 0; gy < GLYPH_HEIGHT; gy++) {
+        blit_rgba_to_dji(target, source, GLYPH_WIDTH);
+        source += GLYPH_WIDTH * BYTES_PER_PIXEL;
+        target += WIDTH * BYTES_PER_PIXEL;
+    }
+}
+
+static void draw_screen(void (*draw_glyph)(uint8_t *, const uint8_t *, uint32_t, uint32_t, uint8_t), uint8_t *fb, const uint8_t *font) {
+    for (uint32_t y = 0; y < GRID_HEIGHT; y++) {
+        for (uint32_t x = 0; x < GRID_WIDTH; x++) {
+            draw_glyph(fb, font, x, y, (x + y * GRID_WIDTH) & 0xFF);
+        }
+    }
+}
+
+int main() {
+    size_t font_size = GLYPH_WIDTH * GLYPH_HEIGHT * BYTES_PER_PIXEL * 256;
+    uint8_t *font = malloc(font_size);
+    for (size_t i = 0; i < font_size; i++) {
+        font[i] = rand();
+    }
+    uint8_t *fb_per_pixel = calloc(WIDTH * HEIGHT, BYTES_PER_PIXEL);
+    uint8_t *fb_rows = calloc(WIDTH * HEIGHT, BYTES_PER_PIXEL);
+
+    draw_screen(&draw_glyph_per_pixel, fb_per_pixel, font);
+    draw_screen(&draw_glyph_rows, fb_rows, font);
+    if (memcmp(fb_per_pixel, fb_rows, WIDTH * HEIGHT * BYTES_PER_PIXEL) != 0) {
+        printf("blit_rgba_to_dji output differs from the per-pixel loop\n");
+        return 1;
+    }
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const char *path = "NEON";
+#else
+    const char *path = "scalar, no NEON on this host";
+#endif
+    double per_pixel_ns, rows_ns;
+    BENCH_NS_PER_ITERATION(per_pixel_ns, 50, draw_screen(&draw_glyph_per_pixel, fb_per_pixel, font));
+    BENCH_NS_PER_ITERATION(rows_ns, 50, draw_screen(&draw_glyph_rows, fb_rows, font));
+    double megapixels = GRID_WIDTH * GRID_HEIGHT * GLYPH_WIDTH * GLYPH_HEIGHT / 1e6;
+    printf("%dx%d HD glyphs per screen, blit_rgba_to_dji built %s\n", GRID_WIDTH, GRID_HEIGHT, path);
+    printf("per-pixel loop:   %8.1f us/screen %7.1f Mpixel/s\n", per_pixel_ns / 1000, megapixels / (per_pixel_ns / 1e9));
+    printf("blit_rgba_to_dji: %8.1f us/screen %7.1f Mpixel/s (%.2fx)\n", rows_ns / 1000, megapixels / (rows_ns / 1e9), per_pixel_ns / rows_ns);
+    free(font);
+    free(fb_per_pixel);
+    free(fb_rows);
+    return 0;
+}
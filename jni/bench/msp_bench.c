@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../msp/msp.h"
+
+// Host benchmark: parse a stream of DisplayPort traffic with msp_process_buffer and with msp_process_data
+// a byte at a time, in UDP datagram sized reads and in small serial sized ones.
+
+#define STREAM_SIZE (1024 * 1024)
+
+static uint32_t message_count;
+static uint32_t payload_sum;
+
+static void count_message(msp_msg_t *msg) {
+    message_count++;
+    payload_sum += msg->size;
+}
+
+static uint32_t build_stream(uint8_t *stream, uint32_t capacity) {
+    // A clear, a screen of 30 character draw_string rows and a draw, repeated, like a FC redrawing its OSD.
+    uint8_t payload[64];
+    uint32_t len = 0;
+    uint8_t row = 0;
+    while (len + MSP_MAX_FRAME_SIZE < capacity) {
+        uint16_t size;
+        if (row == 0) {
+            payload[0] = 2; // clear screen
+            size = 1;
+        } else if (row == 17) {
+            payload[0] = 4; // draw screen
+            size = 1;
+        } else {
+            payload[0] = 3; // draw string
+            payload[1] = row;
+            payload[2] = 0;
+            payload[3] = 0;
+            for (uint8_t i = 0; i < 30; i++) {
+                payload[4 + i] = 'A' + (row + i) % 26;
+            }
+            size = 34;
+        }
+        construct_msp_command(&stream[len], MSP_CMD_DISPLAYPORT, payload, size, MSP_INBOUND, MSP_V1);
+        len += MSP_V1_HEADER_SIZE + size + 1;
+        row = (row + 1) % 18;
+    }
+    return len;
+}
+
+static void parse_bytes(msp_state_t *state, uint8_t *stream, uint32_t len, uint32_t read_size) {
+    for (uint32_t offset = 0; offset < len; offset += read_size) {
+        uint32_t end = offset + read_size < len ? offset + read_size : len;
+        for (uint32_t i = offset; i < end; i++) {
+            msp_process_data(state, stream[i]);
+        }
+    }
+}
+
+static void parse_buffers(msp_state_t *state, uint8_t *stream, uint32_t len, uint32_t read_size) {
+    for (uint32_t offset = 0; offset < len; offset += read_size) {
+        msp_process_buffer(state, &stream[offset], offset + read_size < len ? read_size : len - offset);
+    }
+}
+
+int main() {
+    uint8_t *stream = malloc(STREAM_SIZE);
+    uint32_t len = build_stream(stream, STREAM_SIZE);
+    msp_state_t *state = calloc(1, sizeof(msp_state_t));
+    state->cb = &count_message;
+
+    // both parsers have to see the same messages for the numbers to mean anything
+    parse_bytes(state, stream, len, 64);
+    uint32_t expected_count = message_count, expected_sum = payload_sum;
+    message_count = payload_sum = 0;
+    parse_buffers(state, stream, len, 64);
+    if (message_count != expected_count || payload_sum != expected_sum) {
+        printf("msp_process_buffer parsed %u messages, msp_process_data %u\n", message_count, expected_count);
+        return 1;
+    }
+
+    printf("%u bytes of DisplayPort traffic, %u messages\n", len, expected_count);
+    uint32_t read_sizes[] = { 1400, 64 };
+    for (uint8_t i = 0; i < sizeof(read_sizes) / sizeof(read_sizes[0]); i++) {
+        double bytes_ns, buffer_ns;
+        BENCH_NS_PER_ITERATION(bytes_ns, 10, parse_bytes(state, stream, len, read_sizes[i]));
+        BENCH_NS_PER_ITERATION(buffer_ns, 10, parse_buffers(state, stream, len, read_sizes[i]));
+        printf("%4u byte reads: msp_process_data %7.1f MB/s, msp_process_buffer %7.1f MB/s (%.2fx)\n", read_sizes[i],
+            len / (bytes_ns / 1e3), len / (buffer_ns / 1e3), bytes_ns / buffer_ns);
+    }
+    free(state);
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../util/osd_grid.h"
+
+// Host benchmark: the column-major [x][y] character maps the renderers used to have against osd_grid_t,
+// on the paths that walk them row by row: diffing two frames, checking a frame is unchanged and a full redraw.
+
+#define WIDTH 1440
+#define HEIGHT 810
+#define BYTES_PER_PIXEL 4
+#define GRID_WIDTH 50
+#define GRID_HEIGHT 18
+#define GLYPH_WIDTH 24
+#define GLYPH_HEIGHT 36
+#define X_OFFSET 120
+#define Y_OFFSET 80
+
+static uint16_t old_map[OSD_GRID_MAX_WIDTH][OSD_GRID_MAX_HEIGHT];
+static uint16_t old_previous_map[OSD_GRID_MAX_WIDTH][OSD_GRID_MAX_HEIGHT];
+static uint16_t old_same_map[OSD_GRID_MAX_WIDTH][OSD_GRID_MAX_HEIGHT];
+static uint8_t old_dirty[OSD_GRID_MAX_WIDTH][OSD_GRID_MAX_HEIGHT];
+static osd_grid_t grid;
+static osd_grid_t previous_grid;
+static osd_grid_t same_grid;
+static uint8_t dirty[OSD_GRID_MAX_HEIGHT * OSD_GRID_STRIDE];
+static uint8_t *fb;
+static uint8_t *font;
+
+static uint32_t old_diff() {
+    uint32_t changed = 0;
+    for (uint32_t y = 0; y < GRID_HEIGHT; y++) {
+        for (uint32_t x = 0; x < GRID_WIDTH; x++) {
+            old_dirty[x][y] = old_map[x][y] != old_previous_map[x][y];
+            changed += old_dirty[x][y];
+        }
+    }
+    return changed;
+}
+
+static void draw_glyph(uint32_t x, uint32_t y, uint16_t c) {
+    const uint8_t *source = font + (c & 0xFF) * GLYPH_WIDTH * GLYPH_HEIGHT * BYTES_PER_PIXEL;
+    uint8_t *target = fb + ((y * GLYPH_HEIGHT + Y_OFFSET) * WIDTH + x * GLYPH_WIDTH + X_OFFSET) * BYTES_PER_PIXEL;
+    for (uint32_t gy = 0; gy < GLYPH_HEIGHT; gy++) {
+        memcpy(target, source, GLYPH_WIDTH * BYTES_PER_PIXEL);
+        source += GLYPH_WIDTH * BYTES_PER_PIXEL;
+        target += WIDTH * BYTES_PER_PIXEL;
+    }
+}
+
+static void old_draw() {
+    for (uint32_t y = 0; y < GRID_HEIGHT; y++) {
+        for (uint32_t x = 0; x < GRID_WIDTH; x++) {
+            if (old_map[x][y] != 0) {
+                draw_glyph(x, y, old_map[x][y]);
+            }
+        }
+    }
+}
+
+static void grid_draw() {
+    for (uint32_t y = 0; y < grid.height; y++) {
+        const uint16_t *row = OSD_GRID_ROW(&grid, y);
+        for (uint32_t x = 0; x < grid.width; x++) {
+            if (row[x] != 0) {
+                draw_glyph(x, y, row[x]);
+            }
+        }
+    }
+}
+
+int main() {
+    font = calloc(256, GLYPH_WIDTH * GLYPH_HEIGHT * BYTES_PER_PIXEL);
+    fb = calloc(WIDTH * HEIGHT, BYTES_PER_PIXEL);
+    osd_grid_init(&grid, GRID_WIDTH, GRID_HEIGHT);
+    osd_grid_init(&previous_grid, GRID_WIDTH, GRID_HEIGHT);
+    // a typical OSD: a fifth of the cells in use and two of them changed since the last frame
+    for (uint32_t y = 0; y < GRID_HEIGHT; y++) {
+        for (uint32_t x = 0; x < GRID_WIDTH; x++) {
+            if ((x * 7 + y * 3) % 5 == 0) {
+                old_map[x][y] = old_previous_map[x][y] = 'A';
+                osd_grid_set(&grid, x, y, 'A');
+                osd_grid_set(&previous_grid, x, y, 'A');
+            }
+        }
+    }
+    old_map[10][5] = 'B';
+    osd_grid_set(&grid, 10, 5, 'B');
+    old_map[30][12] = 'C';
+    osd_grid_set(&grid, 30, 12, 'C');
+    memcpy(old_same_map, old_previous_map, sizeof(old_same_map));
+    osd_grid_copy(&same_grid, &previous_grid);
+    if (old_diff() != 2 || osd_grid_diff(&grid, &previous_grid, dirty) != 2) {
+        printf("column-major and osd_grid_diff disagree on what changed\n");
+        return 1;
+    }
+
+    volatile uint32_t sink = 0;
+    double old_ns, grid_ns;
+    printf("%dx%d grid, %d of the cells in use\n", GRID_WIDTH, GRID_HEIGHT, GRID_WIDTH * GRID_HEIGHT / 5);
+    BENCH_NS_PER_ITERATION(old_ns, 100000, sink += old_diff());
+    BENCH_NS_PER_ITERATION(grid_ns, 100000, sink += osd_grid_diff(&grid, &previous_grid, dirty));
+    printf("diff:      column-major %8.2f us, osd_grid_diff  %8.2f us (%.2fx)\n", old_ns / 1e3, grid_ns / 1e3, old_ns / grid_ns);
+    BENCH_NS_PER_ITERATION(old_ns, 100000, sink += memcmp(old_same_map, old_previous_map, sizeof(old_same_map)) == 0);
+    BENCH_NS_PER_ITERATION(grid_ns, 100000, sink += osd_grid_equal(&same_grid, &previous_grid));
+    printf("unchanged: column-major %8.2f us, osd_grid_equal %8.2f us (%.2fx)\n", old_ns / 1e3, grid_ns / 1e3, old_ns / grid_ns);
+    BENCH_NS_PER_ITERATION(old_ns, 200, old_draw());
+    BENCH_NS_PER_ITERATION(grid_ns, 200, grid_draw());
+    printf("redraw:    column-major %8.2f us, osd_grid_t     %8.2f us (%.2fx)\n", old_ns / 1e3, grid_ns / 1e3, old_ns / grid_ns);
+    free(font);
+    free(fb);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../msp/msp.h"
+#include "../util/rle.h"
+
+// Host benchmark: compression ratio and encode/decode time of the link RLE on frame_buffer sized
+// DisplayPort frames shaped like the ones each flight controller firmware sends.
+// These are built here rather than recorded, so the ratios are indicative, not a promise for any one OSD layout.
+
+#define FRAME_SIZE 1400
+
+typedef struct osd_element_s {
+    uint8_t row;
+    uint8_t col;
+    const char *text;
+} osd_element_t;
+
+// Betaflight sends a clear, then each element as a short string where it sits on a 30x16 screen.
+static const osd_element_t betaflight_elements[] = {
+    { 1, 1, "\x01" "16.4V" }, { 1, 23, "\x0c" "05:12" }, { 2, 1, "RSSI 99" }, { 2, 23, "\x9c" "1.20A" },
+    { 7, 14, "\x72\x73\x74" }, { 8, 12, "\x13\x13\x13\x13\x13\x13" }, { 12, 1, "ALT 123M" }, { 12, 21, "SPD  45K" },
+    { 13, 1, "ACRO" }, { 14, 11, "THR  42" }, { 15, 1, "\x7b" "  212MAH" }, { 15, 22, "DIST 250" },
+};
+
+// iNav pads its values to fixed widths and adds a horizon and home arrow, so more spaces go over the wire.
+static const osd_element_t inav_elements[] = {
+    { 0, 1, "\x06" "  16.4V   " }, { 0, 20, "  05:12   " }, { 1, 1, "\x01" " 99   " }, { 1, 20, "  1.20A   " },
+    { 3, 3, "HDG   275 " }, { 5, 6, "                  " }, { 6, 6, "        \x80\x81        " },
+    { 7, 6, "      \x82\x83\x84\x85      " }, { 8, 6, "                  " }, { 10, 1, "  ALT  123M " },
+    { 10, 18, "  GSPD  45K " }, { 13, 1, "MANUAL    " }, { 14, 1, "  THR    42%  " }, { 15, 1, "   212MAH      " },
+    { 15, 18, "  DIST  250M " },
+};
+
+static uint32_t add_string(uint8_t *frame, uint32_t len, uint8_t row, uint8_t col, const char *text, uint8_t text_len) {
+    uint8_t payload[64];
+    payload[0] = 3; // draw string
+    payload[1] = row;
+    payload[2] = col;
+    payload[3] = 0;
+    memcpy(&payload[4], text, text_len);
+    construct_msp_command(&frame[len], MSP_CMD_DISPLAYPORT, payload, 4 + text_len, MSP_INBOUND, MSP_V1);
+    return len + MSP_V1_HEADER_SIZE + 4 + text_len + 1;
+}
+
+static uint32_t add_subcommand(uint8_t *frame, uint32_t len, uint8_t subcommand) {
+    construct_msp_command(&frame[len], MSP_CMD_DISPLAYPORT, &subcommand, 1, MSP_INBOUND, MSP_V1);
+    return len + MSP_V1_HEADER_SIZE + 1 + 1;
+}
+
+static uint32_t build_elements_frame(uint8_t *frame, const osd_element_t *elements, uint8_t count) {
+    uint32_t len = add_subcommand(frame, 0, 2); // clear screen
+    for (uint8_t i = 0; i < count; i++) {
+        len = add_string(frame, len, elements[i].row, elements[i].col, elements[i].text, strlen(elements[i].text));
+    }
+    return add_subcommand(frame, len, 4); // draw screen
+}
+
+static uint32_t build_ardupilot_frame(uint8_t *frame) {
+    // ArduPilot on an HD layout rewrites whole 50 character rows, mostly blank.
+    char row[50];
+    uint32_t len = add_subcommand(frame, 0, 2);
+    for (uint8_t y = 0; y < 18; y++) {
+        memset(row, ' ', sizeof(row));
+        if (y == 0 || y == 17) {
+            memcpy(&row[1], "16.4V 1.20A", 11);
+            memcpy(&row[40], "05:12 99", 8);
+        } else if (y == 9) {
+            memcpy(&row[20], "\x80\x81\x82\x83\x84\x85\x86\x87\x88", 9);
+        } else if (y == 15) {
+            memcpy(&row[1], "ALT 123M SPD 45K", 16);
+        }
+        len = add_string(frame, len, y, 0, row, sizeof(row));
+    }
+    return add_subcommand(frame, len, 4);
+}
+
+static void bench_frame(const char *name, uint8_t *frame, uint32_t len) {
+    static uint8_t encoded[RLE_MAX_ENCODED_SIZE(FRAME_SIZE)];
+    static uint8_t decoded[FRAME_SIZE];
+    // same call as msp_link_send, so a frame that doesn't shrink reports as sent uncompressed
+    uint32_t encoded_len = rle_encode(encoded, len - 1, frame, len);
+    if (encoded_len == 0) {
+        printf("%-10s %4u bytes, does not compress\n", name, len);
+        return;
+    }
+    if (rle_decode(decoded, sizeof(decoded), encoded, encoded_len) != (int32_t)len || memcmp(decoded, frame, len) != 0) {
+        printf("%-10s does not decode back to the frame it was encoded from\n", name);
+        exit(1);
+    }
+    double encode_ns, decode_ns;
+    BENCH_NS_PER_ITERATION(encode_ns, 10000, rle_encode(encoded, len - 1, frame, len));
+    BENCH_NS_PER_ITERATION(decode_ns, 10000, rle_decode(decoded, sizeof(decoded), encoded, encoded_len));
+    printf("%-10s %4u -> %4u bytes (%.2fx), encode %6.2f us %7.1f MB/s, decode %6.2f us %7.1f MB/s\n", name,
+        len, encoded_len, (double)len / encoded_len, encode_ns / 1e3, len / (encode_ns / 1e3),
+        decode_ns / 1e3, len / (decode_ns / 1e3));
+}
+
+int main() {
+    static uint8_t frame[FRAME_SIZE * 2];
+    uint32_t len = build_elements_frame(frame, betaflight_elements, sizeof(betaflight_elements) / sizeof(betaflight_elements[0]));
+    bench_frame("Betaflight", frame, len);
+    len = build_elements_frame(frame, inav_elements, sizeof(inav_elements) / sizeof(inav_elements[0]));
+    bench_frame("iNav", frame, len);
+    len = build_ardupilot_frame(frame);
+    bench_frame("ArduPilot", frame, len);
+    return 0;
+}
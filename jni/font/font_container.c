@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "font_container.h"
+#include "../util/rle.h"
+
+#define BYTES_PER_PIXEL 4
+
+const font_container_page_t *font_container_find_page(const uint8_t *data, size_t size, uint8_t is_hd, uint8_t page) {
+    const font_container_header_t *header = (const font_container_header_t *)data;
+    if (size < sizeof(font_container_header_t)
+        || memcmp(header->magic, FONT_CONTAINER_MAGIC, sizeof(header->magic)) != 0
+        || header->version != FONT_CONTAINER_VERSION
+        || size < sizeof(font_container_header_t) + header->page_count * sizeof(font_container_page_t)) {
+        return NULL;
+    }
+    const font_container_page_t *entries = (const font_container_page_t *)(data + sizeof(font_container_header_t));
+    for (uint8_t i = 0; i < header->page_count; i++) {
+        if (entries[i].is_hd == is_hd && entries[i].page == page) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+int font_container_decode_page(uint8_t *dst, size_t dst_size, const uint8_t *data, size_t size, const font_container_page_t *entry, font_convert_func_t convert) {
+    // Decode a page into dst, already in the render layout when convert is given. Returns 0, or -1 if the page is damaged.
+    size_t pixels = FONT_CONTAINER_PAGE_SIZE(entry) / BYTES_PER_PIXEL;
+    size_t palette_bytes = (size_t)entry->palette_size * BYTES_PER_PIXEL;
+    size_t pixel_bytes = entry->encoding == FONT_ENCODING_RGBA ? pixels * BYTES_PER_PIXEL : pixels;
+    if (dst_size != pixels * BYTES_PER_PIXEL
+        || (entry->encoding != FONT_ENCODING_RGBA && entry->encoding != FONT_ENCODING_PALETTE)
+        || (entry->encoding == FONT_ENCODING_PALETTE && (entry->palette_size == 0 || entry->palette_size > 256))
+        || entry->offset > size || palette_bytes + entry->length > size - entry->offset) {
+        return -1;
+    }
+    const uint8_t *palette = data + entry->offset;
+    const uint8_t *stored = palette + palette_bytes;
+
+    // Unpack RLE pixel bytes into dst itself when they need no further work, otherwise into a scratch buffer.
+    uint8_t *scratch = NULL;
+    const uint8_t *pixel_data = stored;
+    if (entry->flags & FONT_PAGE_FLAG_RLE) {
+        uint8_t in_place = entry->encoding == FONT_ENCODING_RGBA && convert == NULL;
+        uint8_t *unpacked = in_place ? dst : (scratch = malloc(pixel_bytes));
+        if (unpacked == NULL || rle_decode(unpacked, pixel_bytes, stored, entry->length) != (int32_t)pixel_bytes) {
+            free(scratch);
+            return -1;
+        }
+        pixel_data = unpacked;
+    } else if (entry->length != pixel_bytes) {
+        return -1;
+    }
+
+    if (entry->encoding == FONT_ENCODING_RGBA) {
+        if (convert != NULL) {
+            convert(dst, pixel_data, pixels);
+        } else if (pixel_data != dst) {
+            memcpy(dst, pixel_data, pixel_bytes);
+        }
+    } else {
+        // Convert the palette rather than the page, then every pixel is a single 4 byte copy.
+        uint32_t render_palette[256];
+        if (convert != NULL) {
+            convert((uint8_t *)render_palette, palette, entry->palette_size);
+        } else {
+            memcpy(render_palette, palette, palette_bytes);
+        }
+        uint32_t *out = (uint32_t *)dst;
+        for (size_t i = 0; i < pixels; i++) {
+            uint8_t index = pixel_data[i];
+            if (index >= entry->palette_size) {
+                free(scratch);
+                return -1;
+            }
+            out[i] = render_palette[index];
+        }
+    }
+    free(scratch);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <stddef.h>
+#include <stdint.h>
+
+// A single file holding every page of every resolution of a font, built on a host from the font*.bin files by font_pack.
+// font_container_header_t, then page_count font_container_page_t index entries, then each page's palette and pixels.
+// Multi-byte fields are little endian.
+
+#define FONT_CONTAINER_MAGIC "OSDF"
+#define FONT_CONTAINER_VERSION 1
+#define FONT_CONTAINER_SUFFIX ".fnt"
+#define FONT_CONTAINER_MAX_PAGES 8
+#define FONT_CONTAINER_CHARS 256
+
+#define FONT_ENCODING_RGBA 0 // 4 bytes per pixel, exactly as in font*.bin
+#define FONT_ENCODING_PALETTE 1 // 1 byte per pixel indexing palette_size RGBA entries, single colour glyphs with alpha need at most 256
+
+#define FONT_PAGE_FLAG_RLE 0x01 // pixel bytes are RLE encoded, see util/rle.h
+
+// Converts src RGBA pixels into the in-memory font format, for fonts which can't be used straight from the file.
+typedef void (*font_convert_func_t)(uint8_t *dst, const uint8_t *src, uint32_t pixels);
+
+typedef struct font_container_header_s {
+    char magic[4];
+    uint8_t version;
+    uint8_t page_count;
+    uint16_t reserved;
+} __attribute__((packed)) font_container_header_t;
+
+typedef struct font_container_page_s {
+    uint8_t is_hd;
+    uint8_t page;
+    uint8_t glyph_width;
+    uint8_t glyph_height;
+    uint8_t encoding;
+    uint8_t flags;
+    uint16_t palette_size;
+    uint32_t offset; // from the start of the file, palette_size * 4 bytes of palette followed by the pixel bytes
+    uint32_t length; // pixel bytes as stored, after RLE if FONT_PAGE_FLAG_RLE is set
+} __attribute__((packed)) font_container_page_t;
+
+#define FONT_CONTAINER_PAGE_SIZE(entry) ((size_t)(entry)->glyph_width * (entry)->glyph_height * FONT_CONTAINER_CHARS * 4)
+
+const font_container_page_t *font_container_find_page(const uint8_t *data, size_t size, uint8_t is_hd, uint8_t page);
+int font_container_decode_page(uint8_t *dst, size_t dst_size, const uint8_t *data, size_t size, const font_container_page_t *entry, font_convert_func_t convert);
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "font_registry.h"
+
+#define BYTES_PER_PIXEL 4
+
+void font_registry_init(font_registry_t *registry, font_convert_func_t convert, uint8_t bytes_per_pixel) {
+    memset(registry, 0, sizeof(font_registry_t));
+    registry->convert = convert;
+    registry->bytes_per_pixel = convert != NULL ? bytes_per_pixel : BYTES_PER_PIXEL;
+}
+
+static void load_entry(font_registry_t *registry, font_registry_entry_t *entry, size_t size) {
+    printf("Opening font: %s\n", entry->path);
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    stat(entry->path, &st);
+    size_t filesize = st.st_size;
+    if (filesize != size) {
+        if (filesize != 0) {
+            printf("Font was wrong size: %s %d != %d\n", entry->path, filesize, size);
+        }
+        return;
+    }
+    int fd = open(entry->path, O_RDONLY, 0);
+    if (fd < 0) {
+        printf("Could not open file %s\n", entry->path);
+        return;
+    }
+    void *mapped_data = mmap(NULL, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // there is no need to keep an FD open after mmap
+    close(fd);
+    if (mapped_data == MAP_FAILED) {
+        printf("Could not map font %s\n", entry->path);
+        return;
+    }
+    if (registry->convert == NULL) {
+        // Clean file pages, so the kernel can share and drop them like any other file cache.
+        entry->data = mapped_data;
+        entry->is_mapped = 1;
+    } else {
+        // Converted once here for every layout using this page, rather than once per layout.
+        entry->data = malloc(size / BYTES_PER_PIXEL * registry->bytes_per_pixel);
+        if (entry->data != NULL) {
+            registry->convert(entry->data, mapped_data, size / BYTES_PER_PIXEL);
+        }
+        munmap(mapped_data, filesize);
+    }
+    entry->size = size;
+}
+
+static font_registry_entry_t *find_entry(font_registry_t *registry, const char *path) {
+    for (uint8_t i = 0; i < registry->entry_count; i++) {
+        if (strcmp(registry->entries[i].path, path) == 0) {
+            return &registry->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static font_registry_entry_t *add_entry(font_registry_t *registry, const char *path) {
+    if (registry->entry_count >= FONT_REGISTRY_MAX_PATHS) {
+        printf("Too many font paths, not opening %s\n", path);
+        return NULL;
+    }
+    font_registry_entry_t *entry = &registry->entries[registry->entry_count++];
+    memset(entry, 0, sizeof(font_registry_entry_t));
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    return entry;
+}
+
+const void *font_registry_open(font_registry_t *registry, const char *path, size_t size) {
+    font_registry_entry_t *entry = find_entry(registry, path);
+    if (entry != NULL) {
+        // a hit, or a path we already know is no good
+        return entry->size == size ? entry->data : NULL;
+    }
+    if (NULL == (entry = add_entry(registry, path))) {
+        return NULL;
+    }
+    load_entry(registry, entry, size);
+    return entry->data;
+}
+
+static font_registry_entry_t *open_container(font_registry_t *registry, const char *path) {
+    // Containers stay mapped as they are, only the pages decoded from them are converted.
+    font_registry_entry_t *entry = find_entry(registry, path);
+    if (entry != NULL || NULL == (entry = add_entry(registry, path))) {
+        return entry;
+    }
+    int fd = open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        return entry;
+    }
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    fstat(fd, &st);
+    void *mapped_data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapped_data == MAP_FAILED) {
+        printf("Could not map font %s\n", path);
+        return entry;
+    }
+    printf("Opened font container: %s\n", path);
+    entry->data = mapped_data;
+    entry->size = st.st_size;
+    entry->is_mapped = 1;
+    return entry;
+}
+
+static const void *open_container_page(font_registry_t *registry, const char *container_path, uint8_t is_hd, uint8_t page, size_t size) {
+    char path[FONT_REGISTRY_MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s#%s%d", container_path, is_hd ? "hd" : "sd", page + 1);
+    font_registry_entry_t *entry = find_entry(registry, path);
+    if (entry != NULL) {
+        return entry->size == size ? entry->data : NULL;
+    }
+    font_registry_entry_t *container = open_container(registry, container_path);
+    if (container == NULL || container->data == NULL || NULL == (entry = add_entry(registry, path))) {
+        return NULL;
+    }
+    const font_container_page_t *page_entry = font_container_find_page(container->data, container->size, is_hd, page);
+    if (page_entry == NULL || FONT_CONTAINER_PAGE_SIZE(page_entry) != size) {
+        return NULL;
+    }
+    uint8_t *data = malloc(size);
+    if (data == NULL || font_container_decode_page(data, size, container->data, container->size, page_entry, registry->bytes_per_pixel == BYTES_PER_PIXEL ? registry->convert : NULL) < 0) {
+        printf("Font container page was damaged: %s\n", path);
+        free(data);
+        return NULL;
+    }
+    if (registry->bytes_per_pixel != BYTES_PER_PIXEL) {
+        // formats with smaller pixels can't be decoded into directly, so shrink the decoded RGBA page
+        uint8_t *converted = malloc(size / BYTES_PER_PIXEL * registry->bytes_per_pixel);
+        if (converted != NULL) {
+            registry->convert(converted, data, size / BYTES_PER_PIXEL);
+        }
+        free(data);
+        if (NULL == (data = converted)) {
+            return NULL;
+        }
+    }
+    entry->data = data;
+    entry->size = size;
+    return data;
+}
+
+const void *font_registry_find(font_registry_t *registry, const char *const *prefixes, uint8_t prefix_count, uint8_t is_hd, uint8_t page, size_t size) {
+    // Try each prefix in order, e.g. /storage/sdcard0/font then /blackbox/font, building the page file name the same way for each.
+    char path[FONT_REGISTRY_MAX_PATH_LENGTH];
+    for (uint8_t i = 0; i < prefix_count; i++) {
+        snprintf(path, sizeof(path), "%s%s", prefixes[i], FONT_CONTAINER_SUFFIX);
+        const void *font = open_container_page(registry, path, is_hd, page, size);
+        if (font != NULL) {
+            return font;
+        }
+        snprintf(path, sizeof(path), "%s%s", prefixes[i], is_hd ? "_hd" : "");
+        size_t len = strlen(path);
+        if (page > 0) {
+            snprintf(path + len, sizeof(path) - len, "_%d.bin", page + 1);
+        } else {
+            snprintf(path + len, sizeof(path) - len, ".bin");
+        }
+        font = font_registry_open(registry, path, size);
+        if (font != NULL) {
+            return font;
+        }
+    }
+    return NULL;
+}
+
+void font_registry_close(font_registry_t *registry) {
+    for (uint8_t i = 0; i < registry->entry_count; i++) {
+        font_registry_entry_t *entry = &registry->entries[i];
+        if (entry->data == NULL) {
+            continue;
+        }
+        if (entry->is_mapped) {
+            munmap(entry->data, entry->size);
+        } else {
+            free(entry->data);
+        }
+    }
+    registry->entry_count = 0;
+}
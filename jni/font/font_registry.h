@@ -0,0 +1,30 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "font_container.h"
+
+// Every font page the OSD opens, each loaded at most once and shared read-only between display layouts.
+// Pages come from a font container (see font_container.h) or a font*.bin file, container first for each prefix.
+// Paths which turned out to be missing or the wrong size are remembered too, so fallback chains are only probed once.
+
+#define FONT_REGISTRY_MAX_PATHS 48
+#define FONT_REGISTRY_MAX_PATH_LENGTH 255
+
+typedef struct font_registry_entry_s {
+    char path[FONT_REGISTRY_MAX_PATH_LENGTH]; // a file, or container path#page for pages decoded from a container
+    void *data; // NULL if the path failed to load
+    size_t size;
+    uint8_t is_mapped; // data is the file mapping itself rather than a converted copy
+} font_registry_entry_t;
+
+typedef struct font_registry_s {
+    font_convert_func_t convert; // NULL to map fonts in place
+    uint8_t bytes_per_pixel; // of converted fonts, which may be smaller than the 4 byte RGBA files
+    uint8_t entry_count;
+    font_registry_entry_t entries[FONT_REGISTRY_MAX_PATHS];
+} font_registry_t;
+
+void font_registry_init(font_registry_t *registry, font_convert_func_t convert, uint8_t bytes_per_pixel);
+const void *font_registry_open(font_registry_t *registry, const char *path, size_t size);
+const void *font_registry_find(font_registry_t *registry, const char *const *prefixes, uint8_t prefix_count, uint8_t is_hd, uint8_t page, size_t size);
+void font_registry_close(font_registry_t *registry);
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "glyph_spans.h"
+
+static uint8_t pixel_is_visible(const uint8_t *row, uint32_t x, glyph_format_t format) {
+    if (format == GLYPH_FORMAT_MASK) {
+        return (row[x] >> 4) != 0;
+    }
+    // DJI has a backwards alpha channel - FF is transparent, 00 is opaque.
+    return row[x * 4 + 3] != 0xFF;
+}
+
+int glyph_spans_build(glyph_spans_t *spans, const void *font, uint8_t glyph_width, uint8_t glyph_height, glyph_format_t format) {
+    memset(spans, 0, sizeof(glyph_spans_t));
+    spans->rows = malloc(GLYPH_SPANS_CHARS * glyph_height * sizeof(glyph_span_t));
+    if (spans->rows == NULL) {
+        return -1;
+    }
+    spans->font = font;
+    spans->glyph_width = glyph_width;
+    spans->glyph_height = glyph_height;
+    uint32_t bytes_per_pixel = format == GLYPH_FORMAT_MASK ? 1 : 4;
+    const uint8_t *row = font;
+    glyph_span_t *span = spans->rows;
+    for (uint32_t c = 0; c < GLYPH_SPANS_CHARS; c++) {
+        spans->top[c] = glyph_height;
+        spans->bottom[c] = 0;
+        for (uint32_t gy = 0; gy < glyph_height; gy++) {
+            uint32_t start = 0;
+            uint32_t end = glyph_width;
+            while (start < glyph_width && !pixel_is_visible(row, start, format)) {
+                start++;
+            }
+            while (end > start && !pixel_is_visible(row, end - 1, format)) {
+                end--;
+            }
+            if (start == end) {
+                start = end = 0;
+            } else {
+                if (gy < spans->top[c]) {
+                    spans->top[c] = gy;
+                }
+                spans->bottom[c] = gy + 1;
+            }
+            span->start = start;
+            span->end = end;
+            span++;
+            row += glyph_width * bytes_per_pixel;
+        }
+        if (spans->top[c] > spans->bottom[c]) {
+            spans->top[c] = spans->bottom[c] = 0;
+        }
+    }
+    return 0;
+}
+
+void glyph_spans_free(glyph_spans_t *spans) {
+    free(spans->rows);
+    memset(spans, 0, sizeof(glyph_spans_t));
+}
@@ -0,0 +1,28 @@
+#include <stdint.h>
+
+// Where each glyph of a font page actually has ink, so drawing can skip the fully transparent rows and row ends
+// and leave the cleared background there instead.
+
+#define GLYPH_SPANS_CHARS 256
+
+typedef enum glyph_format_e {
+    GLYPH_FORMAT_DJI = 0, // 4 byte DJI pixels, alpha byte 0xFF is transparent
+    GLYPH_FORMAT_MASK = 1, // 1 byte masks, coverage nibble 0 is transparent, see blit_rgba_to_mask
+} glyph_format_t;
+
+typedef struct glyph_span_s {
+    uint8_t start;
+    uint8_t end; // [start, end) covers every visible pixel of the row, start == end when there are none
+} glyph_span_t;
+
+typedef struct glyph_spans_s {
+    const void *font; // the page these spans were built from
+    uint8_t glyph_width;
+    uint8_t glyph_height;
+    uint8_t top[GLYPH_SPANS_CHARS]; // rows [top, bottom) hold all of a glyph's ink, top == bottom for blank glyphs
+    uint8_t bottom[GLYPH_SPANS_CHARS];
+    glyph_span_t *rows; // glyph_height spans per glyph
+} glyph_spans_t;
+
+int glyph_spans_build(glyph_spans_t *spans, const void *font, uint8_t glyph_width, uint8_t glyph_height, glyph_format_t format);
+void glyph_spans_free(glyph_spans_t *spans);
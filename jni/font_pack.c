@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "font/font_container.h"
+#include "util/rle.h"
+
+// Host tool: pack font.bin, font_2.bin, font_hd.bin and font_hd_2.bin into a single font container for the goggles.
+
+#define BYTES_PER_PIXEL 4
+
+#define SD_GLYPH_WIDTH 36
+#define SD_GLYPH_HEIGHT 54
+#define HD_GLYPH_WIDTH 24
+#define HD_GLYPH_HEIGHT 36
+
+typedef struct packed_page_s {
+    font_container_page_t entry;
+    uint32_t palette[256];
+    uint8_t *data;
+} packed_page_t;
+
+static uint8_t *read_file(const char *path, size_t expected_size) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return NULL;
+    }
+    if ((size_t)st.st_size != expected_size) {
+        printf("Font was wrong size: %s %ld != %zu\n", path, (long)st.st_size, expected_size);
+        return NULL;
+    }
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    uint8_t *data = malloc(expected_size);
+    if (fread(data, 1, expected_size, file) != expected_size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+static int build_palette(packed_page_t *packed, const uint32_t *pixels, size_t count, uint8_t *indices, uint8_t ignore_transparent_colour) {
+    // Returns the number of palette entries, or -1 if the page has more than 256 distinct pixels.
+    int palette_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel = pixels[i];
+        if (ignore_transparent_colour && ((uint8_t *)&pixel)[3] == 0) {
+            // the colour of a fully transparent pixel never reaches the screen
+            pixel = 0;
+        }
+        int index = palette_size - 1;
+        // glyphs mostly repeat the previous pixel, so search backwards from the newest entry
+        if (i == 0 || pixel != packed->palette[indices[i - 1]]) {
+            while (index >= 0 && packed->palette[index] != pixel) {
+                index--;
+            }
+        } else {
+            index = indices[i - 1];
+        }
+        if (index < 0) {
+            if (palette_size == 256) {
+                return -1;
+            }
+            packed->palette[palette_size] = pixel;
+            index = palette_size++;
+        }
+        indices[i] = index;
+    }
+    return palette_size;
+}
+
+static void pack_page(packed_page_t *packed, const uint8_t *rgba, uint8_t is_hd, uint8_t page) {
+    font_container_page_t *entry = &packed->entry;
+    memset(entry, 0, sizeof(font_container_page_t));
+    entry->is_hd = is_hd;
+    entry->page = page;
+    entry->glyph_width = is_hd ? HD_GLYPH_WIDTH : SD_GLYPH_WIDTH;
+    entry->glyph_height = is_hd ? HD_GLYPH_HEIGHT : SD_GLYPH_HEIGHT;
+    size_t pixel_count = FONT_CONTAINER_PAGE_SIZE(entry) / BYTES_PER_PIXEL;
+
+    // Palette pages are a quarter of the size, try to keep exact colours first.
+    uint8_t *raw = malloc(pixel_count * BYTES_PER_PIXEL);
+    size_t raw_size;
+    int palette_size = build_palette(packed, (const uint32_t *)rgba, pixel_count, raw, 0);
+    if (palette_size < 0) {
+        palette_size = build_palette(packed, (const uint32_t *)rgba, pixel_count, raw, 1);
+    }
+    if (palette_size > 0) {
+        entry->encoding = FONT_ENCODING_PALETTE;
+        entry->palette_size = palette_size;
+        raw_size = pixel_count;
+    } else {
+        entry->encoding = FONT_ENCODING_RGBA;
+        memcpy(raw, rgba, pixel_count * BYTES_PER_PIXEL);
+        raw_size = pixel_count * BYTES_PER_PIXEL;
+    }
+
+    // Glyph cells are mostly transparent, so RLE usually wins by a wide margin, but keep the raw bytes if it doesn't.
+    uint32_t encoded_capacity = RLE_MAX_ENCODED_SIZE(raw_size);
+    uint8_t *encoded = malloc(encoded_capacity);
+    uint32_t encoded_size = rle_encode(encoded, encoded_capacity, raw, raw_size);
+    if (encoded_size > 0 && encoded_size < raw_size) {
+        entry->flags |= FONT_PAGE_FLAG_RLE;
+        entry->length = encoded_size;
+        packed->data = encoded;
+        free(raw);
+    } else {
+        entry->length = raw_size;
+        packed->data = raw;
+        free(encoded);
+    }
+    printf("%s page %d: %s, %d colours, %zu -> %u bytes\n", is_hd ? "HD" : "SD", page + 1,
+        entry->encoding == FONT_ENCODING_PALETTE ? "palette" : "RGBA", entry->palette_size,
+        pixel_count * BYTES_PER_PIXEL, entry->length + entry->palette_size * BYTES_PER_PIXEL);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("usage: font_pack output%s font_prefix\nreads font_prefix.bin, font_prefix_2.bin, font_prefix_hd.bin and font_prefix_hd_2.bin, skipping any that are missing\n", FONT_CONTAINER_SUFFIX);
+        return 0;
+    }
+    const char *output_path = argv[1];
+    const char *prefix = argv[2];
+
+    packed_page_t pages[4];
+    uint8_t page_count = 0;
+    char path[255];
+    for (uint8_t is_hd = 0; is_hd < 2; is_hd++) {
+        for (uint8_t page = 0; page < 2; page++) {
+            snprintf(path, sizeof(path), "%s%s%s", prefix, is_hd ? "_hd" : "", page > 0 ? "_2.bin" : ".bin");
+            size_t size = (size_t)(is_hd ? HD_GLYPH_WIDTH * HD_GLYPH_HEIGHT : SD_GLYPH_WIDTH * SD_GLYPH_HEIGHT) * FONT_CONTAINER_CHARS * BYTES_PER_PIXEL;
+            uint8_t *rgba = read_file(path, size);
+            if (rgba == NULL) {
+                continue;
+            }
+            printf("Packing %s\n", path);
+            pack_page(&pages[page_count++], rgba, is_hd, page);
+            free(rgba);
+        }
+    }
+    if (page_count == 0) {
+        printf("No font pages found for %s\n", prefix);
+        return 1;
+    }
+
+    font_container_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FONT_CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = FONT_CONTAINER_VERSION;
+    header.page_count = page_count;
+    uint32_t offset = sizeof(header) + page_count * sizeof(font_container_page_t);
+    for (uint8_t i = 0; i < page_count; i++) {
+        pages[i].entry.offset = offset;
+        offset += pages[i].entry.palette_size * BYTES_PER_PIXEL + pages[i].entry.length;
+    }
+
+    FILE *output = fopen(output_path, "wb");
+    if (output == NULL) {
+        printf("Could not open %s\n", output_path);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, output);
+    for (uint8_t i = 0; i < page_count; i++) {
+        fwrite(&pages[i].entry, sizeof(font_container_page_t), 1, output);
+    }
+    for (uint8_t i = 0; i < page_count; i++) {
+        fwrite(pages[i].palette, BYTES_PER_PIXEL, pages[i].entry.palette_size, output);
+        fwrite(pages[i].data, 1, pages[i].entry.length, output);
+        free(pages[i].data);
+    }
+    fclose(output);
+    printf("Wrote %s, %u bytes\n", output_path, offset);
+    return 0;
+}
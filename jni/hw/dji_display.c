@@ -4,15 +4,20 @@
 #define GOGGLES_V1_VOFFSET 575
 #define GOGGLES_V2_VOFFSET 215
 
+#define FB_IN_USE 1u
+#define FB_PUSH_SEQ(state) ((state) & ~FB_IN_USE)
+
 static duss_result_t pop_func(duss_disp_instance_handle_t *disp_handle,duss_disp_plane_id_t plane_id, duss_frame_buffer_t *frame_buffer,void *user_ctx) {
+    dji_display_frame_popped((dji_display_state_t *)user_ctx, frame_buffer);
     return 0;
 }
 
 dji_display_state_t *dji_display_state_alloc(uint8_t is_v2_goggles) {
     dji_display_state_t *display_state = calloc(1, sizeof(dji_display_state_t));
     display_state->disp_instance_handle = (duss_disp_instance_handle_t *)calloc(1, sizeof(duss_disp_instance_handle_t));
-    display_state->fb_0 = (duss_frame_buffer_t *)calloc(1,sizeof(duss_frame_buffer_t));
-    display_state->fb_1 = (duss_frame_buffer_t *)calloc(1,sizeof(duss_frame_buffer_t));
+    for (int i = 0; i < DJI_DISPLAY_BUFFER_COUNT; i++) {
+        display_state->fbs[i] = (duss_frame_buffer_t *)calloc(1,sizeof(duss_frame_buffer_t));
+    }
     display_state->pb_0 = (duss_disp_plane_blending_t *)calloc(1, sizeof(duss_disp_plane_blending_t));
     display_state->is_v2_goggles = is_v2_goggles;
     return display_state;
@@ -20,8 +25,9 @@ dji_display_state_t *dji_display_state_alloc(uint8_t is_v2_goggles) {
 
 void dji_display_state_free(dji_display_state_t *display_state) {
     free(display_state->disp_instance_handle);
-    free(display_state->fb_0);
-    free(display_state->fb_1);
+    for (int i = 0; i < DJI_DISPLAY_BUFFER_COUNT; i++) {
+        free(display_state->fbs[i]);
+    }
     free(display_state->pb_0);
     free(display_state);
 }
@@ -31,8 +37,9 @@ void dji_display_close_framebuffer(dji_display_state_t *display_state) {
     duss_hal_display_port_enable(display_state->disp_instance_handle, 3, 0);
     duss_hal_display_release_plane(display_state->disp_instance_handle, display_state->plane_id);
     duss_hal_display_close(display_state->disp_handle, &display_state->disp_instance_handle);
-    duss_hal_mem_free(display_state->ion_buf_0);
-    duss_hal_mem_free(display_state->ion_buf_1);
+    for (int i = 0; i < DJI_DISPLAY_BUFFER_COUNT; i++) {
+        duss_hal_mem_free(display_state->ion_bufs[i]);
+    }
     duss_hal_device_close(display_state->disp_handle);
     duss_hal_device_stop(display_state->ion_handle);
     duss_hal_device_close(display_state->ion_handle);
@@ -94,7 +101,7 @@ void dji_display_open_framebuffer(dji_display_state_t *display_state, duss_disp_
         printf("failed to acquire plane");
         exit(0);
     }
-    res = duss_hal_display_register_frame_cycle_callback(display_state->disp_instance_handle, plane_id, &pop_func, 0);
+    res = duss_hal_display_register_frame_cycle_callback(display_state->disp_instance_handle, plane_id, &pop_func, display_state);
     if (res != 0) {
         printf("failed to register callback");
         exit(0);
@@ -122,43 +129,31 @@ void dji_display_open_framebuffer(dji_display_state_t *display_state, duss_disp_
         exit(0);
     }
 
-    res = duss_hal_mem_alloc(display_state->ion_handle,&display_state->ion_buf_0,0x473100,0x400,0,0x17);
-    if (res != 0) {
-        printf("failed to allocate VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_map(display_state->ion_buf_0, &display_state->fb0_virtual_addr);
-    if (res != 0) {
-        printf("failed to map VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_get_phys_addr(display_state->ion_buf_0, &display_state->fb0_physical_addr);
-    if (res != 0) {
-        printf("failed to get FB0 phys addr");
-        exit(0);
-    }
-    printf("first buffer VRAM mapped virtual memory is at %p : %p\n", display_state->fb0_virtual_addr, display_state->fb0_physical_addr);
+    dji_display_allocate_buffers(display_state);
+}
 
-    res = duss_hal_mem_alloc(display_state->ion_handle,&display_state->ion_buf_1,0x473100,0x400,0,0x17);
-    if (res != 0) {
-        printf("failed to allocate FB1 VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_map(display_state->ion_buf_1,&display_state->fb1_virtual_addr);
-    if (res != 0) {
-        printf("failed to map FB1 VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_get_phys_addr(display_state->ion_buf_1, &display_state->fb1_physical_addr);
-    if (res != 0) {
-        printf("failed to get FB1 phys addr");
-        exit(0);
-    }
-    printf("second buffer VRAM mapped virtual memory is at %p : %p\n", display_state->fb1_virtual_addr, display_state->fb1_physical_addr);
-    
-    for(int i = 0; i < 2; i++) {
-        duss_frame_buffer_t *fb = i ? display_state->fb_1 : display_state->fb_0;
-        fb->buffer = i ? display_state->ion_buf_1 : display_state->ion_buf_0;
+void dji_display_allocate_buffers(dji_display_state_t *display_state) {
+    duss_result_t res = 0;
+    for(int i = 0; i < DJI_DISPLAY_BUFFER_COUNT; i++) {
+        res = duss_hal_mem_alloc(display_state->ion_handle,&display_state->ion_bufs[i],0x473100,0x400,0,0x17);
+        if (res != 0) {
+            printf("failed to allocate FB%d VRAM", i);
+            exit(0);
+        }
+        res = duss_hal_mem_map(display_state->ion_bufs[i], &display_state->fb_virtual_addrs[i]);
+        if (res != 0) {
+            printf("failed to map FB%d VRAM", i);
+            exit(0);
+        }
+        res = duss_hal_mem_get_phys_addr(display_state->ion_bufs[i], &display_state->fb_physical_addrs[i]);
+        if (res != 0) {
+            printf("failed to get FB%d phys addr", i);
+            exit(0);
+        }
+        printf("buffer %d VRAM mapped virtual memory is at %p : %p\n", i, display_state->fb_virtual_addrs[i], display_state->fb_physical_addrs[i]);
+
+        duss_frame_buffer_t *fb = display_state->fbs[i];
+        fb->buffer = display_state->ion_bufs[i];
         fb->pixel_format = display_state->is_v2_goggles ? DUSS_PIXFMT_RGBA8888_GOGGLES_V2 : DUSS_PIXFMT_RGBA8888; // 20012 instead on V2
         fb->frame_id = i;
         fb->planes[0].bytes_per_line = 0x1680;
@@ -168,16 +163,68 @@ void dji_display_open_framebuffer(dji_display_state_t *display_state, duss_disp_
         fb->width = 1440;
         fb->height = 810;
         fb->plane_count = 1;
+        __atomic_store_n(&display_state->fb_state[i], 0, __ATOMIC_RELEASE);
+    }
+    display_state->last_pushed_fb = DJI_DISPLAY_BUFFER_COUNT - 1;
+}
+
+int dji_display_acquire_buffer(dji_display_state_t *display_state) {
+    // Returns a buffer the display is done with, or -1 if they are all on screen or queued. Never blocks.
+    for (int i = 1; i <= DJI_DISPLAY_BUFFER_COUNT; i++) {
+        // hand them out round robin, starting after the last one pushed
+        int fb = (display_state->last_pushed_fb + i) % DJI_DISPLAY_BUFFER_COUNT;
+        if (!(__atomic_load_n(&display_state->fb_state[fb], __ATOMIC_ACQUIRE) & FB_IN_USE)) {
+            return fb;
+        }
+    }
+    return -1;
+}
+
+void dji_display_frame_popped(dji_display_state_t *display_state, duss_frame_buffer_t *frame_buffer) {
+    // Called from the frame cycle callback on the HAL's thread. Whether the popped buffer is the one that just went on
+    // screen or the one that just came off, every buffer pushed before it is done with, so release those.
+    for (int popped = 0; popped < DJI_DISPLAY_BUFFER_COUNT; popped++) {
+        if (display_state->fbs[popped] != frame_buffer) {
+            continue;
+        }
+        uint32_t popped_seq = FB_PUSH_SEQ(__atomic_load_n(&display_state->fb_state[popped], __ATOMIC_ACQUIRE));
+        for (int i = 0; i < DJI_DISPLAY_BUFFER_COUNT; i++) {
+            uint32_t state = __atomic_load_n(&display_state->fb_state[i], __ATOMIC_ACQUIRE);
+            if ((state & FB_IN_USE) && (int32_t)(FB_PUSH_SEQ(state) - popped_seq) < 0) {
+                // If the render thread pushed this buffer again since the load, the swap fails and the new push stays in use.
+                __atomic_compare_exchange_n(&display_state->fb_state[i], &state, FB_PUSH_SEQ(state), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+            }
+        }
+        __atomic_store_n(&display_state->has_release_callback, 1, __ATOMIC_RELAXED);
     }
 }
 
 void dji_display_push_frame(dji_display_state_t *display_state, uint8_t which_fb) {
-    duss_frame_buffer_t *fb = which_fb ? display_state->fb_1 : display_state->fb_0;
-    duss_hal_mem_sync(fb->buffer, 1);
+    dji_display_push_frame_dirty(display_state, which_fb, 1);
+}
+
+void dji_display_push_frame_dirty(dji_display_state_t *display_state, uint8_t which_fb, uint8_t dirty) {
+    // dirty is whether the buffer was written at all since it was last pushed.
+    duss_frame_buffer_t *fb = display_state->fbs[which_fb];
+    if (!__atomic_load_n(&display_state->has_release_callback, __ATOMIC_RELAXED)) {
+        // Without release reports, assume one flip per push: once this one is queued, only the buffer on screen now is still busy.
+        for (int i = 0; i < DJI_DISPLAY_BUFFER_COUNT; i++) {
+            if (i != display_state->last_pushed_fb) {
+                __atomic_fetch_and(&display_state->fb_state[i], ~FB_IN_USE, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    __atomic_store_n(&display_state->fb_state[which_fb], (++display_state->push_count << 1) | FB_IN_USE, __ATOMIC_RELEASE);
+    display_state->last_pushed_fb = which_fb;
+    if (dirty) {
+        // libduml_hal only exposes a whole-buffer cache clean, so there is nothing finer than this to track.
+        // A buffer that was not written at all (it already held this frame) skips the clean entirely.
+        duss_hal_mem_sync(fb->buffer, 1);
+    }
     duss_hal_display_push_frame(display_state->disp_instance_handle, display_state->plane_id, fb);
 }
 
 void *dji_display_get_fb_address(dji_display_state_t *display_state, uint8_t which_fb) {
-     return which_fb ? display_state->fb1_virtual_addr : display_state->fb0_virtual_addr;
+     return display_state->fb_virtual_addrs[which_fb];
 }
 
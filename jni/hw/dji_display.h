@@ -2,25 +2,35 @@
 #define DJI_DISPLAY_H
 #include "duml_hal.h"
 
+// Three buffers let us always have one to draw into while one is on screen and another is queued for the next flip.
+#define DJI_DISPLAY_BUFFER_COUNT 3
+
 typedef struct dji_display_state_s {
     duss_disp_plane_id_t plane_id;
     duss_hal_obj_handle_t disp_handle;
     duss_hal_obj_handle_t ion_handle;
     duss_disp_vop_id_t vop_id;
-    duss_hal_mem_handle_t ion_buf_0;
-    duss_hal_mem_handle_t ion_buf_1;
-    void * fb0_virtual_addr;
-    void * fb0_physical_addr;
-    void * fb1_virtual_addr;
-    void * fb1_physical_addr;
+    duss_hal_mem_handle_t ion_bufs[DJI_DISPLAY_BUFFER_COUNT];
+    void * fb_virtual_addrs[DJI_DISPLAY_BUFFER_COUNT];
+    void * fb_physical_addrs[DJI_DISPLAY_BUFFER_COUNT];
     duss_disp_instance_handle_t *disp_instance_handle;
-    duss_frame_buffer_t *fb_0;
-    duss_frame_buffer_t *fb_1;
+    duss_frame_buffer_t *fbs[DJI_DISPLAY_BUFFER_COUNT];
     duss_disp_plane_blending_t *pb_0;
     uint8_t is_v2_goggles;
+    // Buffer ownership, shared with the HAL thread that runs the frame cycle callback, so only touched with __atomic builtins.
+    // push_count when each buffer was last pushed, shifted up one, with the low bit set while it is pushed and not released yet.
+    // One word, so the HAL thread can release exactly the push it saw with a compare and swap.
+    uint32_t fb_state[DJI_DISPLAY_BUFFER_COUNT];
+    uint8_t has_release_callback; // the frame cycle callback has reported a popped buffer at least once
+    uint8_t last_pushed_fb;
+    uint32_t push_count;
 } dji_display_state_t;
 
+void dji_display_allocate_buffers(dji_display_state_t *display_state);
+int dji_display_acquire_buffer(dji_display_state_t *display_state);
+void dji_display_frame_popped(dji_display_state_t *display_state, duss_frame_buffer_t *frame_buffer);
 void dji_display_push_frame(dji_display_state_t *display_state, uint8_t which_fb);
+void dji_display_push_frame_dirty(dji_display_state_t *display_state, uint8_t which_fb, uint8_t dirty);
 void dji_display_open_framebuffer(dji_display_state_t *display_state, duss_disp_plane_id_t plane_id);
 void dji_display_close_framebuffer(dji_display_state_t *display_state);
 dji_display_state_t *dji_display_state_alloc(uint8_t is_v2_goggles);
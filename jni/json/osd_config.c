@@ -19,4 +19,22 @@ int get_boolean_config_value(const char* key) {
     } else {
         return 0;
     }
+}
+
+int get_integer_config_value(const char* key) {
+    load_config();
+    if (root_object != NULL) {
+        return (int)json_object_get_number(root_object, key);
+    } else {
+        return 0;
+    }
+}
+
+const char *get_string_config_value(const char* key) {
+    load_config();
+    if (root_object != NULL) {
+        return json_object_get_string(root_object, key);
+    } else {
+        return NULL;
+    }
 }
\ No newline at end of file
@@ -3,31 +3,117 @@
 #include <stdio.h>
 #include "msp.h"
 
+// CRC-8/DVB-S2 (polynomial 0xD5), as used by MSP V2
+static const uint8_t crc8_dvb_s2_table[256] = {
+    0x00, 0xD5, 0x7F, 0xAA, 0xFE, 0x2B, 0x81, 0x54,
+    0x29, 0xFC, 0x56, 0x83, 0xD7, 0x02, 0xA8, 0x7D,
+    0x52, 0x87, 0x2D, 0xF8, 0xAC, 0x79, 0xD3, 0x06,
+    0x7B, 0xAE, 0x04, 0xD1, 0x85, 0x50, 0xFA, 0x2F,
+    0xA4, 0x71, 0xDB, 0x0E, 0x5A, 0x8F, 0x25, 0xF0,
+    0x8D, 0x58, 0xF2, 0x27, 0x73, 0xA6, 0x0C, 0xD9,
+    0xF6, 0x23, 0x89, 0x5C, 0x08, 0xDD, 0x77, 0xA2,
+    0xDF, 0x0A, 0xA0, 0x75, 0x21, 0xF4, 0x5E, 0x8B,
+    0x9D, 0x48, 0xE2, 0x37, 0x63, 0xB6, 0x1C, 0xC9,
+    0xB4, 0x61, 0xCB, 0x1E, 0x4A, 0x9F, 0x35, 0xE0,
+    0xCF, 0x1A, 0xB0, 0x65, 0x31, 0xE4, 0x4E, 0x9B,
+    0xE6, 0x33, 0x99, 0x4C, 0x18, 0xCD, 0x67, 0xB2,
+    0x39, 0xEC, 0x46, 0x93, 0xC7, 0x12, 0xB8, 0x6D,
+    0x10, 0xC5, 0x6F, 0xBA, 0xEE, 0x3B, 0x91, 0x44,
+    0x6B, 0xBE, 0x14, 0xC1, 0x95, 0x40, 0xEA, 0x3F,
+    0x42, 0x97, 0x3D, 0xE8, 0xBC, 0x69, 0xC3, 0x16,
+    0xEF, 0x3A, 0x90, 0x45, 0x11, 0xC4, 0x6E, 0xBB,
+    0xC6, 0x13, 0xB9, 0x6C, 0x38, 0xED, 0x47, 0x92,
+    0xBD, 0x68, 0xC2, 0x17, 0x43, 0x96, 0x3C, 0xE9,
+    0x94, 0x41, 0xEB, 0x3E, 0x6A, 0xBF, 0x15, 0xC0,
+    0x4B, 0x9E, 0x34, 0xE1, 0xB5, 0x60, 0xCA, 0x1F,
+    0x62, 0xB7, 0x1D, 0xC8, 0x9C, 0x49, 0xE3, 0x36,
+    0x19, 0xCC, 0x66, 0xB3, 0xE7, 0x32, 0x98, 0x4D,
+    0x30, 0xE5, 0x4F, 0x9A, 0xCE, 0x1B, 0xB1, 0x64,
+    0x72, 0xA7, 0x0D, 0xD8, 0x8C, 0x59, 0xF3, 0x26,
+    0x5B, 0x8E, 0x24, 0xF1, 0xA5, 0x70, 0xDA, 0x0F,
+    0x20, 0xF5, 0x5F, 0x8A, 0xDE, 0x0B, 0xA1, 0x74,
+    0x09, 0xDC, 0x76, 0xA3, 0xF7, 0x22, 0x88, 0x5D,
+    0xD6, 0x03, 0xA9, 0x7C, 0x28, 0xFD, 0x57, 0x82,
+    0xFF, 0x2A, 0x80, 0x55, 0x01, 0xD4, 0x7E, 0xAB,
+    0x84, 0x51, 0xFB, 0x2E, 0x7A, 0xAF, 0x05, 0xD0,
+    0xAD, 0x78, 0xD2, 0x07, 0x53, 0x86, 0x2C, 0xF9
+};
+
+uint8_t msp_crc8_dvb_s2(uint8_t crc, uint8_t *buf, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        crc = crc8_dvb_s2_table[crc ^ buf[i]];
+    }
+    return crc;
+}
+
+static uint8_t msp_checksum_span(uint8_t *buf, uint32_t len) {
+    uint8_t checksum = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        checksum ^= buf[i];
+    }
+    return checksum;
+}
+
+static uint8_t msp_checksum_update(msp_version_e version, uint8_t checksum, uint8_t *buf, uint32_t len) {
+    // V1 frames carry an XOR checksum, V2 frames a CRC8
+    if (version == MSP_V2) {
+        return msp_crc8_dvb_s2(checksum, buf, len);
+    }
+    return checksum ^ msp_checksum_span(buf, len);
+}
+
 uint16_t msp_data_from_msg(uint8_t message_buffer[], msp_msg_t *msg) {
     // return size
-    construct_msp_command(message_buffer, msg->cmd, msg->payload, msg->size, msg->direction);
-    return msg->size + 6;
+    msp_version_e version = msg->version;
+    if (version == MSP_V1 && (msg->size > 255 || msg->cmd > 255)) {
+        // too big for a V1 frame, so send it as V2 rather than not at all
+        version = MSP_V2;
+    }
+    if (construct_msp_command(message_buffer, msg->cmd, msg->payload, msg->size, msg->direction, version) != MSP_ERR_NONE) {
+        return 0;
+    }
+    if (version == MSP_V2) {
+        if (msg->flags != 0) {
+            message_buffer[3] = msg->flags;
+            message_buffer[MSP_V2_HEADER_SIZE + msg->size] = msp_crc8_dvb_s2(0, &message_buffer[3], MSP_V2_HEADER_SIZE - 3 + msg->size);
+        }
+        return msg->size + MSP_V2_HEADER_SIZE + 1;
+    }
+    return msg->size + MSP_V1_HEADER_SIZE + 1;
 }
 
-msp_error_e construct_msp_command(uint8_t message_buffer[], uint8_t command, uint8_t payload[], uint8_t size, msp_direction_e direction) {
-    uint8_t checksum;
+msp_error_e construct_msp_command(uint8_t message_buffer[], uint16_t command, uint8_t payload[], uint16_t size, msp_direction_e direction, msp_version_e version) {
+    uint16_t header_size;
     message_buffer[0] = '$'; // Header
-    message_buffer[1] = 'M'; // MSP V1
     if (direction == MSP_OUTBOUND) {
         message_buffer[2] = '<';
     } else {
         message_buffer[2] = '>';
     }
-    message_buffer[3] = size; // Payload Size
-    checksum = size;
-    message_buffer[4] = command; // Command
-    checksum ^= command;
-    for(uint8_t i = 0; i < size; i++) {
-        message_buffer[5 + i] = payload[i];
-        checksum ^= message_buffer[5 + i];
+    if (version == MSP_V2) {
+        if (size > MSP_MAX_PAYLOAD_SIZE) {
+            return MSP_ERR_LEN;
+        }
+        message_buffer[1] = 'X'; // MSP V2
+        message_buffer[3] = 0; // Flags
+        message_buffer[4] = command & 0xFF; // Command
+        message_buffer[5] = command >> 8;
+        message_buffer[6] = size & 0xFF; // Payload Size
+        message_buffer[7] = size >> 8;
+        header_size = MSP_V2_HEADER_SIZE;
+    } else {
+        if (size > 255 || command > 255) {
+            return MSP_ERR_LEN;
+        }
+        message_buffer[1] = 'M'; // MSP V1
+        message_buffer[3] = size; // Payload Size
+        message_buffer[4] = command; // Command
+        header_size = MSP_V1_HEADER_SIZE;
     }
-    message_buffer[5 + size] = checksum;
-    return 0;
+    memcpy(&message_buffer[header_size], payload, size);
+    // The checksum covers everything after the direction byte: size and command for V1, flags, command and size for V2
+    message_buffer[header_size + size] = msp_checksum_update(version, 0, &message_buffer[3], header_size - 3 + size);
+    return MSP_ERR_NONE;
 }
 
 msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat)
@@ -45,9 +131,15 @@ msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat)
                 return MSP_ERR_HDR;
             }
             break;
-        case MSP_VERSION: // Look for 'M' (MSP V1, we do not support V2 at this time)
+        case MSP_VERSION: // Look for 'M' (MSP V1) or 'X' (MSP V2)
             if (dat == 'M')
             {
+                msp_state->message.version = MSP_V1;
+                msp_state->state = MSP_DIRECTION;
+            }
+            else if (dat == 'X')
+            {
+                msp_state->message.version = MSP_V2;
                 msp_state->state = MSP_DIRECTION;
             }
             else
@@ -57,7 +149,7 @@ msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat)
             }
             break;
         case MSP_DIRECTION: // < for command, > for reply
-            msp_state->state = MSP_SIZE;
+            msp_state->state = msp_state->message.version == MSP_V2 ? MSP_V2_FLAGS : MSP_SIZE;
             switch (dat)
             {
             case '<':
@@ -75,13 +167,8 @@ msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat)
         case MSP_SIZE: // next up is supposed to be size
             msp_state->message.checksum = dat;
             msp_state->message.size = dat;
+            msp_state->message.flags = 0;
             msp_state->state = MSP_CMD;
-            if (msp_state->message.size > 256)
-            { // bogus message, too big. this can't actually happen but good to check
-                msp_state->state = MSP_IDLE;
-                return MSP_ERR_LEN;
-                break;
-            }
             break;
         case MSP_CMD: // followed by command
             msp_state->message.cmd = dat;
@@ -96,9 +183,47 @@ msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat)
                 msp_state->state = MSP_CHECKSUM;
             }
             break;
+        case MSP_V2_FLAGS: // V2: flags, then 16-bit command and size, all little endian
+            msp_state->message.flags = dat;
+            msp_state->message.checksum = msp_crc8_dvb_s2(0, &dat, 1);
+            msp_state->state = MSP_V2_CMD_LOW;
+            break;
+        case MSP_V2_CMD_LOW:
+            msp_state->message.cmd = dat;
+            msp_state->message.checksum = msp_crc8_dvb_s2(msp_state->message.checksum, &dat, 1);
+            msp_state->state = MSP_V2_CMD_HIGH;
+            break;
+        case MSP_V2_CMD_HIGH:
+            msp_state->message.cmd |= (uint16_t)dat << 8;
+            msp_state->message.checksum = msp_crc8_dvb_s2(msp_state->message.checksum, &dat, 1);
+            msp_state->state = MSP_V2_SIZE_LOW;
+            break;
+        case MSP_V2_SIZE_LOW:
+            msp_state->message.size = dat;
+            msp_state->message.checksum = msp_crc8_dvb_s2(msp_state->message.checksum, &dat, 1);
+            msp_state->state = MSP_V2_SIZE_HIGH;
+            break;
+        case MSP_V2_SIZE_HIGH:
+            msp_state->message.size |= (uint16_t)dat << 8;
+            msp_state->message.checksum = msp_crc8_dvb_s2(msp_state->message.checksum, &dat, 1);
+            if (msp_state->message.size > MSP_MAX_PAYLOAD_SIZE)
+            { // bogus or oversized message, we have nowhere to put it
+                msp_state->state = MSP_IDLE;
+                return MSP_ERR_LEN;
+            }
+            msp_state->buf_ptr = 0;
+            if (msp_state->message.size > 0)
+            {
+                msp_state->state = MSP_PAYLOAD;
+            }
+            else
+            {
+                msp_state->state = MSP_CHECKSUM;
+            }
+            break;
         case MSP_PAYLOAD: // if we had a payload, keep going
-            msp_state->message.payload[msp_state->buf_ptr] = dat;
-            msp_state->message.checksum ^= dat;
+            msp_state->message.payload_buffer[msp_state->buf_ptr] = dat;
+            msp_state->message.checksum = msp_checksum_update(msp_state->message.version, msp_state->message.checksum, &dat, 1);
             msp_state->buf_ptr++;
             if (msp_state->buf_ptr == msp_state->message.size)
             {
@@ -111,9 +236,11 @@ msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat)
             {
                 if (msp_state->cb != 0)
                 {
+                    msp_state->message.payload = msp_state->message.payload_buffer;
+                    msp_state->message.frame = NULL;
+                    msp_state->message.frame_size = 0;
                     msp_state->cb(&msp_state->message);
                 }
-                memset(&msp_state->message, 0, sizeof(msp_msg_t));
                 msp_state->state = MSP_IDLE;
                 break;            
             }
@@ -125,4 +252,134 @@ msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat)
             break;
     }
     return MSP_ERR_NONE;
-}
\ No newline at end of file
+}
+
+static uint32_t msp_process_contiguous_frame(msp_state_t *msp_state, uint8_t *frame, uint32_t len, msp_error_e *error)
+{
+    // If a whole frame starts at frame[0], deliver it straight from the input buffer and return its length.
+    // Returns 0 if the frame is incomplete or its header is not valid, leaving it to the state machine.
+    msp_version_e version;
+    uint16_t header_size;
+    uint16_t cmd;
+    uint16_t size;
+    uint8_t flags = 0;
+    if (len < 3 || (frame[2] != '<' && frame[2] != '>'))
+    {
+        return 0;
+    }
+    if (frame[1] == 'M' && len >= MSP_V1_HEADER_SIZE)
+    {
+        version = MSP_V1;
+        header_size = MSP_V1_HEADER_SIZE;
+        size = frame[3];
+        cmd = frame[4];
+    }
+    else if (frame[1] == 'X' && len >= MSP_V2_HEADER_SIZE)
+    {
+        version = MSP_V2;
+        header_size = MSP_V2_HEADER_SIZE;
+        flags = frame[3];
+        cmd = frame[4] | ((uint16_t)frame[5] << 8);
+        size = frame[6] | ((uint16_t)frame[7] << 8);
+        if (size > MSP_MAX_PAYLOAD_SIZE)
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+    uint32_t frame_size = header_size + size + 1;
+    if (frame_size > len)
+    {
+        return 0;
+    }
+    uint8_t checksum = msp_checksum_update(version, 0, &frame[3], header_size - 3 + size);
+    if (checksum != frame[frame_size - 1])
+    {
+        *error = MSP_ERR_CKS;
+        return frame_size;
+    }
+    msp_msg_t *message = &msp_state->message;
+    message->direction = frame[2] == '<' ? MSP_OUTBOUND : MSP_INBOUND;
+    message->version = version;
+    message->flags = flags;
+    message->size = size;
+    message->cmd = cmd;
+    message->checksum = checksum;
+    // no copy, the callback reads the payload where it sits in the input buffer
+    message->payload = &frame[header_size];
+    message->frame = frame;
+    message->frame_size = frame_size;
+    if (msp_state->cb != 0)
+    {
+        msp_state->cb(message);
+    }
+    message->payload = message->payload_buffer;
+    message->frame = NULL;
+    message->frame_size = 0;
+    return frame_size;
+}
+
+msp_error_e msp_process_buffer(msp_state_t *msp_state, uint8_t *buf, uint32_t len)
+{
+    // Same state machine as msp_process_data, but skips garbage and copies payloads a span at a time.
+    // Frames that fit entirely in buf are handed to the callback with msg->frame and msg->payload pointing into buf.
+    // Frames split across calls pick up where they left off. Returns the last error seen, if any.
+    msp_error_e result = MSP_ERR_NONE;
+    uint32_t i = 0;
+    while (i < len)
+    {
+        if (msp_state->state == MSP_IDLE)
+        {
+            uint8_t *header = memchr(&buf[i], '$', len - i);
+            if (header == NULL)
+            {
+                return MSP_ERR_HDR;
+            }
+            if (header != &buf[i])
+            {
+                result = MSP_ERR_HDR;
+            }
+            i = header - buf;
+            uint32_t consumed = msp_process_contiguous_frame(msp_state, header, len - i, &result);
+            if (consumed > 0)
+            {
+                i += consumed;
+            }
+            else
+            {
+                i++;
+                msp_state->state = MSP_VERSION;
+            }
+        }
+        else if (msp_state->state == MSP_PAYLOAD)
+        {
+            uint32_t count = msp_state->message.size - msp_state->buf_ptr;
+            if (count > len - i)
+            {
+                count = len - i;
+            }
+            memcpy(&msp_state->message.payload_buffer[msp_state->buf_ptr], &buf[i], count);
+            msp_state->message.checksum = msp_checksum_update(msp_state->message.version, msp_state->message.checksum, &buf[i], count);
+            msp_state->buf_ptr += count;
+            i += count;
+            if (msp_state->buf_ptr == msp_state->message.size)
+            {
+                msp_state->buf_ptr = 0;
+                msp_state->state = MSP_CHECKSUM;
+            }
+        }
+        else
+        {
+            msp_error_e error = msp_process_data(msp_state, buf[i]);
+            if (error != MSP_ERR_NONE)
+            {
+                result = error;
+            }
+            i++;
+        }
+    }
+    return result;
+}
@@ -13,6 +13,11 @@
 #define MSP_CMD_STATUS_EX 150
 #define MSP_CMD_DISPLAYPORT 182
 
+#define MSP_V1_HEADER_SIZE 5 // $ M < size cmd
+#define MSP_V2_HEADER_SIZE 8 // $ X < flags cmd(16) size(16)
+#define MSP_MAX_PAYLOAD_SIZE 1024
+#define MSP_MAX_FRAME_SIZE (MSP_V2_HEADER_SIZE + MSP_MAX_PAYLOAD_SIZE + 1)
+
 typedef enum {
     MSP_ERR_NONE,
     MSP_ERR_HDR,
@@ -26,6 +31,11 @@ typedef enum {
     MSP_DIRECTION,
     MSP_SIZE,
     MSP_CMD,
+    MSP_V2_FLAGS,
+    MSP_V2_CMD_LOW,
+    MSP_V2_CMD_HIGH,
+    MSP_V2_SIZE_LOW,
+    MSP_V2_SIZE_HIGH,
     MSP_PAYLOAD,
     MSP_CHECKSUM,
 } msp_state_machine_e;
@@ -35,12 +45,22 @@ typedef enum {
     MSP_OUTBOUND
 } msp_direction_e;
 
+typedef enum {
+    MSP_V1,
+    MSP_V2
+} msp_version_e;
+
 typedef struct msp_msg_s {
     uint8_t checksum;
-    uint8_t cmd;
-    uint8_t size;
+    uint16_t cmd;
+    uint16_t size;
     msp_direction_e direction;
-    uint8_t payload[256];
+    msp_version_e version;
+    uint8_t flags; // MSP V2 only
+    uint8_t *payload; // into frame when there is one, otherwise payload_buffer
+    uint8_t *frame; // the whole encoded message in the caller's input buffer, NULL if it arrived split across reads
+    uint16_t frame_size;
+    uint8_t payload_buffer[MSP_MAX_PAYLOAD_SIZE]; // where split messages are reassembled
 } msp_msg_t;
 
 typedef void (*msp_msg_callback)(msp_msg_t *);
@@ -48,10 +68,12 @@ typedef void (*msp_msg_callback)(msp_msg_t *);
 typedef struct msp_state_s {
     msp_msg_callback cb;
     msp_state_machine_e state;
-    uint8_t buf_ptr;
+    uint16_t buf_ptr;
     msp_msg_t message;
 } msp_state_t;
 
+uint8_t msp_crc8_dvb_s2(uint8_t crc, uint8_t *buf, uint32_t len);
 uint16_t msp_data_from_msg(uint8_t message_buffer[], msp_msg_t *msg);
-msp_error_e construct_msp_command(uint8_t message_buffer[], uint8_t command, uint8_t payload[], uint8_t size, msp_direction_e direction);
-msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat);
\ No newline at end of file
+msp_error_e construct_msp_command(uint8_t message_buffer[], uint16_t command, uint8_t payload[], uint16_t size, msp_direction_e direction, msp_version_e version);
+msp_error_e msp_process_data(msp_state_t *msp_state, uint8_t dat);
+msp_error_e msp_process_buffer(msp_state_t *msp_state, uint8_t *buf, uint32_t len);
@@ -1,18 +1,25 @@
 #include "msp.h"
 #include "msp_displayport.h"
 
-static void process_draw_string(displayport_vtable_t *display_driver, uint8_t *payload) {
-    if(!display_driver || !display_driver->draw_character) return;
+static void process_draw_string(displayport_vtable_t *display_driver, uint8_t *payload, uint16_t size) {
+    if(!display_driver || (!display_driver->draw_string && !display_driver->draw_character)) return;
+    if(size < 3) return;
     uint8_t row = payload[0];
     uint8_t col = payload[1];
     uint8_t attrs = payload[2]; // iNav uses this to specify which font page to draw from
-    uint8_t str_len;
-    for(str_len = 1; str_len < 255; str_len++) {
-        if(payload[2 + str_len] == '\0') {
+    // The string runs to the end of the payload, or to a NUL if the FC sent one.
+    uint16_t str_len;
+    for(str_len = 0; str_len < (size - 3); str_len++) {
+        if(payload[3 + str_len] == '\0') {
             break;
         }
     }
-    for(uint8_t idx = 0; idx < (str_len - 1); idx++) {
+    if(display_driver->draw_string) {
+        // hand the whole run over at once, so the driver can clip it once
+        display_driver->draw_string(col, row, &payload[3], str_len, attrs & 0x1);
+        return;
+    }
+    for(uint16_t idx = 0; idx < str_len; idx++) {
         uint16_t character = payload[3 + idx];
         if(attrs & 0x1) {
             // shift over a page if one was specified
@@ -52,7 +59,7 @@ int displayport_process_message(displayport_vtable_t *display_driver, msp_msg_t
     if (msg->direction != MSP_INBOUND) {
         return 1;
     }
-    if (msg->cmd != MSP_CMD_DISPLAYPORT) {
+    if (msg->cmd != MSP_CMD_DISPLAYPORT || msg->size == 0) {
         return 1;
     }
     uint8_t sub_cmd = msg->payload[0];
@@ -67,7 +74,7 @@ int displayport_process_message(displayport_vtable_t *display_driver, msp_msg_t
             process_clear_screen(display_driver);
             break;
         case 3: // 3 -> Draw String
-            process_draw_string(display_driver, &msg->payload[1]);
+            process_draw_string(display_driver, &msg->payload[1], msg->size - 1);
             break;
         case 4: // 4 -> Draw Screen
             process_draw_complete(display_driver);
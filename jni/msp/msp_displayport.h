@@ -1,12 +1,14 @@
 #include <stdint.h>
 
 typedef void (*draw_character_func)(uint32_t x, uint32_t y, uint16_t c);
+typedef void (*draw_string_func)(uint32_t x, uint32_t y, uint8_t *string, uint16_t len, uint8_t page);
 typedef void (*set_options_func)(uint8_t font, uint8_t is_hd);
 typedef void (*clear_screen_func)();
 typedef void (*draw_complete_func)();
 
 typedef struct displayport_vtable_s {
     draw_character_func draw_character;
+    draw_string_func draw_string; // optional, draw_character is used per character if this is NULL
     clear_screen_func clear_screen;
     draw_complete_func draw_complete;
     set_options_func set_options;
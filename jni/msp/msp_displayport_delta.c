@@ -0,0 +1,170 @@
+#include <string.h>
+#include "msp.h"
+#include "msp_displayport.h"
+#include "msp_displayport_delta.h"
+
+// A changed cell this close after the previous one joins its run, since resending a few unchanged cells is cheaper than a new run header.
+#define DELTA_MERGE_DISTANCE ((int)sizeof(displayport_delta_run_t))
+
+void displayport_delta_encoder_init(displayport_delta_encoder_t *encoder) {
+    memset(encoder, 0, sizeof(displayport_delta_encoder_t));
+    encoder->force_keyframe = 1;
+}
+
+void displayport_delta_draw_string(displayport_delta_encoder_t *encoder, uint32_t x, uint32_t y, uint8_t *string, uint16_t len, uint8_t page) {
+    if (x >= DISPLAYPORT_DELTA_MAX_X || y >= DISPLAYPORT_DELTA_MAX_Y) {
+        return;
+    }
+    if (len > DISPLAYPORT_DELTA_MAX_X - x) {
+        len = DISPLAYPORT_DELTA_MAX_X - x;
+    }
+    uint16_t page_bits = (uint16_t)page << 8;
+    for (uint16_t i = 0; i < len; i++) {
+        encoder->character_map[x + i][y] = string[i] | page_bits;
+    }
+}
+
+void displayport_delta_clear_screen(displayport_delta_encoder_t *encoder) {
+    memset(encoder->character_map, 0, sizeof(encoder->character_map));
+}
+
+void displayport_delta_set_options(displayport_delta_encoder_t *encoder, uint8_t font, uint8_t is_hd) {
+    // The goggles clear their screen on set_options, so the next packet has to carry everything.
+    displayport_delta_clear_screen(encoder);
+    encoder->has_options = 1;
+    encoder->font = font;
+    encoder->is_hd = is_hd;
+    encoder->force_keyframe = 1;
+}
+
+static uint8_t cell_changed(displayport_delta_encoder_t *encoder, uint8_t keyframe, uint8_t x, uint8_t y) {
+    if (keyframe) {
+        // a keyframe starts from a blank screen
+        return encoder->character_map[x][y] != 0;
+    }
+    return encoder->character_map[x][y] != encoder->sent_character_map[x][y];
+}
+
+uint16_t displayport_delta_encode(displayport_delta_encoder_t *encoder, uint8_t *buf, uint8_t keyframe) {
+    // Write one committed frame of changes since the last call into buf, which must hold DISPLAYPORT_DELTA_MAX_PACKET_SIZE bytes.
+    keyframe = keyframe || encoder->force_keyframe;
+    displayport_delta_header_t *header = (displayport_delta_header_t *)buf;
+    header->magic = DISPLAYPORT_DELTA_MAGIC;
+    header->flags = DISPLAYPORT_DELTA_FLAG_COMMIT;
+    header->font = encoder->font;
+    if (keyframe) {
+        header->flags |= DISPLAYPORT_DELTA_FLAG_KEYFRAME;
+    }
+    if (encoder->has_options) {
+        header->flags |= DISPLAYPORT_DELTA_FLAG_OPTIONS;
+        if (encoder->is_hd) {
+            header->flags |= DISPLAYPORT_DELTA_FLAG_HD;
+        }
+    }
+    uint16_t cursor = sizeof(displayport_delta_header_t);
+
+    for (uint8_t y = 0; y < DISPLAYPORT_DELTA_MAX_Y; y++) {
+        uint8_t x = 0;
+        while (x < DISPLAYPORT_DELTA_MAX_X) {
+            if (!cell_changed(encoder, keyframe, x, y)) {
+                x++;
+                continue;
+            }
+            // Grow the run over following cells on the same font page, for as long as changes keep turning up.
+            uint8_t page = encoder->character_map[x][y] >> 8;
+            uint8_t last_changed = x;
+            for (uint8_t i = x + 1; i < DISPLAYPORT_DELTA_MAX_X && (i - last_changed) <= DELTA_MERGE_DISTANCE; i++) {
+                if ((encoder->character_map[i][y] >> 8) != page) {
+                    break;
+                }
+                if (cell_changed(encoder, keyframe, i, y)) {
+                    last_changed = i;
+                }
+            }
+            displayport_delta_run_t *run = (displayport_delta_run_t *)&buf[cursor];
+            run->x = x;
+            run->y = y;
+            run->len = last_changed - x + 1;
+            run->page = page;
+            cursor += sizeof(displayport_delta_run_t);
+            for (uint8_t i = x; i <= last_changed; i++) {
+                buf[cursor++] = encoder->character_map[i][y] & 0xFF;
+            }
+            x = last_changed + 1;
+        }
+    }
+
+    memcpy(encoder->sent_character_map, encoder->character_map, sizeof(encoder->sent_character_map));
+    encoder->force_keyframe = 0;
+    return cursor;
+}
+
+uint16_t displayport_delta_split(uint8_t *packet, uint16_t len, uint16_t *cursor, uint8_t *chunk, uint16_t chunk_size) {
+    // Copy the next chunk_size worth of whole runs from an encoded packet into chunk, as a packet of its own.
+    // Only the first chunk clears the screen and only the last one draws it. Returns 0 once the packet is used up.
+    // Start with *cursor at 0.
+    uint16_t header_size = sizeof(displayport_delta_header_t);
+    if (*cursor == 0) {
+        *cursor = header_size;
+    } else if (*cursor >= len) {
+        return 0;
+    }
+    displayport_delta_header_t *header = (displayport_delta_header_t *)chunk;
+    memcpy(header, packet, header_size);
+    if (*cursor > header_size) {
+        header->flags &= ~DISPLAYPORT_DELTA_FLAG_KEYFRAME;
+    }
+    uint16_t chunk_len = header_size;
+    while (*cursor < len) {
+        displayport_delta_run_t *run = (displayport_delta_run_t *)&packet[*cursor];
+        uint16_t run_size = sizeof(displayport_delta_run_t) + run->len;
+        if (chunk_len + run_size > chunk_size) {
+            break;
+        }
+        memcpy(&chunk[chunk_len], run, run_size);
+        chunk_len += run_size;
+        *cursor += run_size;
+    }
+    if (*cursor < len) {
+        header->flags &= ~DISPLAYPORT_DELTA_FLAG_COMMIT;
+    }
+    return chunk_len;
+}
+
+int displayport_delta_apply(displayport_vtable_t *display_driver, uint8_t *buf, uint16_t len) {
+    // Replay a delta packet through the same driver callbacks as MSP DisplayPort messages.
+    if (len < sizeof(displayport_delta_header_t)) {
+        return 1;
+    }
+    displayport_delta_header_t *header = (displayport_delta_header_t *)buf;
+    if (header->magic != DISPLAYPORT_DELTA_MAGIC) {
+        return 1;
+    }
+    if (header->flags & DISPLAYPORT_DELTA_FLAG_KEYFRAME) {
+        if ((header->flags & DISPLAYPORT_DELTA_FLAG_OPTIONS) && display_driver->set_options) {
+            display_driver->set_options(header->font, (header->flags & DISPLAYPORT_DELTA_FLAG_HD) ? 1 : 0);
+        } else if (display_driver->clear_screen) {
+            display_driver->clear_screen();
+        }
+    }
+    uint16_t cursor = sizeof(displayport_delta_header_t);
+    while (cursor + sizeof(displayport_delta_run_t) <= len) {
+        displayport_delta_run_t *run = (displayport_delta_run_t *)&buf[cursor];
+        cursor += sizeof(displayport_delta_run_t);
+        if (cursor + run->len > len) {
+            return 1;
+        }
+        if (display_driver->draw_string) {
+            display_driver->draw_string(run->x, run->y, &buf[cursor], run->len, run->page);
+        } else if (display_driver->draw_character) {
+            for (uint8_t i = 0; i < run->len; i++) {
+                display_driver->draw_character(run->x + i, run->y, buf[cursor + i] | ((uint16_t)run->page << 8));
+            }
+        }
+        cursor += run->len;
+    }
+    if ((header->flags & DISPLAYPORT_DELTA_FLAG_COMMIT) && display_driver->draw_complete) {
+        display_driver->draw_complete();
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <stdint.h>
+
+// Cell-delta encoding of the DisplayPort character grid, sent from the air unit instead of raw MSP frames.
+// A packet is a displayport_delta_header_t followed by runs, each a displayport_delta_run_t and then
+// len character bytes from font page `page`. Packets never start with '$', so they can share a socket with raw MSP.
+
+#define DISPLAYPORT_DELTA_MAGIC 0xDE
+
+#define DISPLAYPORT_DELTA_MAX_X 60
+#define DISPLAYPORT_DELTA_MAX_Y 22
+
+#define DISPLAYPORT_DELTA_FLAG_KEYFRAME 0x01 // clear the screen before applying the runs
+#define DISPLAYPORT_DELTA_FLAG_COMMIT 0x02 // draw the screen after applying the runs
+#define DISPLAYPORT_DELTA_FLAG_OPTIONS 0x04 // font and is_hd are valid, as set by the FC
+#define DISPLAYPORT_DELTA_FLAG_HD 0x08
+
+// worst case, every cell changed and alternated font page so no runs could be merged
+#define DISPLAYPORT_DELTA_MAX_PACKET_SIZE (sizeof(displayport_delta_header_t) + (DISPLAYPORT_DELTA_MAX_X * DISPLAYPORT_DELTA_MAX_Y) * (sizeof(displayport_delta_run_t) + 1))
+
+typedef struct displayport_delta_header_s {
+    uint8_t magic;
+    uint8_t flags;
+    uint8_t font;
+} __attribute__((packed)) displayport_delta_header_t;
+
+typedef struct displayport_delta_run_s {
+    uint8_t x;
+    uint8_t y;
+    uint8_t len;
+    uint8_t page;
+} __attribute__((packed)) displayport_delta_run_t;
+
+typedef struct displayport_delta_encoder_s {
+    uint16_t character_map[DISPLAYPORT_DELTA_MAX_X][DISPLAYPORT_DELTA_MAX_Y];
+    uint16_t sent_character_map[DISPLAYPORT_DELTA_MAX_X][DISPLAYPORT_DELTA_MAX_Y];
+    uint8_t has_options;
+    uint8_t font;
+    uint8_t is_hd;
+    uint8_t force_keyframe;
+} displayport_delta_encoder_t;
+
+void displayport_delta_encoder_init(displayport_delta_encoder_t *encoder);
+void displayport_delta_draw_string(displayport_delta_encoder_t *encoder, uint32_t x, uint32_t y, uint8_t *string, uint16_t len, uint8_t page);
+void displayport_delta_clear_screen(displayport_delta_encoder_t *encoder);
+void displayport_delta_set_options(displayport_delta_encoder_t *encoder, uint8_t font, uint8_t is_hd);
+uint16_t displayport_delta_encode(displayport_delta_encoder_t *encoder, uint8_t *buf, uint8_t keyframe);
+uint16_t displayport_delta_split(uint8_t *packet, uint16_t len, uint16_t *cursor, uint8_t *chunk, uint16_t chunk_size);
+int displayport_delta_apply(displayport_vtable_t *display_driver, uint8_t *buf, uint16_t len);
@@ -8,9 +8,12 @@
 #include "hw/dji_radio_shm.h"
 #include "json/osd_config.h"
 #include "net/data_protocol.h"
+#include "net/msp_link.h"
 #include "net/network.h"
 #include "net/serial.h"
 #include "msp/msp.h"
+#include "msp/msp_displayport.h"
+#include "msp/msp_displayport_delta.h"
 #include "util/time_util.h"
 #include "util/fs_util.h"
 
@@ -19,6 +22,13 @@
 
 #define FAST_SERIAL_KEY "fast_serial"
 #define CACHE_SERIAL_KEY "cache_serial"
+#define DELTA_OSD_KEY "delta_osd"
+#define FEC_GROUP_SIZE_KEY "fec_group_size"
+#define COMPRESS_OSD_KEY "compress_osd"
+#define OSD_MAX_HOLD_KEY "osd_max_hold_ms"
+
+// In delta mode, resend the whole screen this often so the goggles recover from lost packets.
+#define DELTA_KEYFRAME_INTERVAL_NS NSEC_PER_SEC
 
 // The MSP_PORT is used to send MSP passthrough messages.
 // The DATA_PORT is used to send arbitrary data - for example, bitrate and temperature data.
@@ -37,19 +47,30 @@ typedef struct msp_cache_entry_s {
     msp_msg_t message;
 } msp_cache_entry_t;
 
-static msp_cache_entry_t *msp_message_cache[256]; // make a slot for all possible messages
+static msp_cache_entry_t *msp_message_cache[256]; // make a slot for all possible V1 messages, V2-only commands are never cached
 
-static uint8_t frame_buffer[8192]; // buffer a whole frame of MSP commands until we get a draw command
+static uint8_t frame_buffer[MSP_LINK_MAX_CHUNK_SIZE]; // buffer MSP commands until we get a draw command or fill a datagram, always fits at least one MSP_MAX_FRAME_SIZE command
 static uint32_t fb_cursor = 0;
 
-static uint8_t message_buffer[256]; // only needs to be the maximum size of an MSP packet, we only care to fwd MSP
+static uint8_t message_buffer[MSP_MAX_FRAME_SIZE]; // only needs to be the maximum size of an MSP packet, we only care to fwd MSP
+
+static displayport_delta_encoder_t delta_encoder; // shadow character grid, only sent as changed cells
+static uint8_t delta_packet[DISPLAYPORT_DELTA_MAX_PACKET_SIZE];
+static uint8_t delta_chunk[MSP_LINK_MAX_CHUNK_SIZE];
+static struct timespec last_keyframe;
 
 int pty_fd;
 int serial_fd;
 int socket_fd;
+static msp_link_tx_t msp_link;
 
 static volatile sig_atomic_t quit = 0;
 static uint8_t serial_passthrough = 1;
+static uint8_t delta_osd = 0;
+
+static uint32_t osd_max_hold_ms = 0; // 0 waits for the FC's draw command forever
+static uint8_t frame_pending = 0; // DisplayPort updates were buffered or applied since the goggles last drew
+static struct timespec frame_pending_since;
 
 static void sig_handler(int _)
 {
@@ -60,6 +81,10 @@ static uint8_t cache_msp_message(msp_msg_t *msp_message) {
     // 0 -> cache overwritten
     // 1 -> freshly cached
     uint8_t retval = 0;
+    if (msp_message->cmd >= 256) {
+        // no cache slot, so always treat it as fresh
+        return 1;
+    }
     msp_cache_entry_t *cache_message = msp_message_cache[msp_message->cmd];
     if (cache_message == NULL) {
         DEBUG_PRINT("FC -> AU CACHE: no entry for msg %d, allocating\n", msp_message->cmd);
@@ -69,12 +94,20 @@ static uint8_t cache_msp_message(msp_msg_t *msp_message) {
     }
     DEBUG_PRINT ("FC -> AU CACHE: refreshing %d\n", msp_message->cmd);
     memcpy(&cache_message->message, msp_message, sizeof(msp_msg_t));
+    // the frame and payload can point into the serial read buffer, which won't outlive this callback
+    memcpy(cache_message->message.payload_buffer, msp_message->payload, msp_message->size);
+    cache_message->message.payload = cache_message->message.payload_buffer;
+    cache_message->message.frame = NULL;
+    cache_message->message.frame_size = 0;
     clock_gettime(CLOCK_MONOTONIC, &cache_message->time);
     return retval;
 }
 
-static int16_t msp_msg_from_cache(uint8_t msg_buffer[], uint8_t cmd_id) {
+static int16_t msp_msg_from_cache(uint8_t msg_buffer[], uint16_t cmd_id) {
     // returns size of message or -1
+    if (cmd_id >= 256) {
+        return -1;
+    }
     msp_cache_entry_t *cache_message = msp_message_cache[cmd_id];
     if (cache_message == NULL) {
         // cache missed, return -1 to trigger a serial send
@@ -100,31 +133,104 @@ static int16_t msp_msg_from_cache(uint8_t msg_buffer[], uint8_t cmd_id) {
     }
 }
 
+static uint16_t msp_message_bytes(msp_msg_t *msp_message, uint8_t **data) {
+    // Forward the bytes exactly as they arrived when the parser gave us a view of them, otherwise re-encode.
+    if (msp_message->frame != NULL) {
+        *data = msp_message->frame;
+        return msp_message->frame_size;
+    }
+    *data = message_buffer;
+    return msp_data_from_msg(message_buffer, msp_message);
+}
+
+static void delta_draw_character(uint32_t x, uint32_t y, uint16_t c) {
+    uint8_t character = c & 0xFF;
+    displayport_delta_draw_string(&delta_encoder, x, y, &character, 1, c >> 8);
+}
+
+static void delta_draw_string(uint32_t x, uint32_t y, uint8_t *string, uint16_t len, uint8_t page) {
+    displayport_delta_draw_string(&delta_encoder, x, y, string, len, page);
+}
+
+static void delta_clear_screen() {
+    displayport_delta_clear_screen(&delta_encoder);
+}
+
+static void delta_set_options(uint8_t font, uint8_t is_hd) {
+    displayport_delta_set_options(&delta_encoder, font, is_hd);
+}
+
+static void mark_frame_pending() {
+    if(!frame_pending) {
+        frame_pending = 1;
+        clock_gettime(CLOCK_MONOTONIC, &frame_pending_since);
+    }
+}
+
+static void send_delta_frame(uint8_t last_flags) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint8_t keyframe = timespec_subtract_ns(&now, &last_keyframe) > DELTA_KEYFRAME_INTERVAL_NS;
+    if(keyframe) {
+        last_keyframe = now;
+    }
+    uint16_t size = displayport_delta_encode(&delta_encoder, delta_packet, keyframe);
+    uint16_t cursor = 0;
+    uint16_t chunk_size;
+    while(0 < (chunk_size = displayport_delta_split(delta_packet, size, &cursor, delta_chunk, sizeof(delta_chunk)))) {
+        msp_link_send(&msp_link, socket_fd, cursor < size ? MSP_LINK_FLAG_MORE : last_flags, delta_chunk, chunk_size);
+    }
+    frame_pending = 0;
+    DEBUG_PRINT("DRAW! wrote %d delta bytes%s\n", size, keyframe ? " (keyframe)" : "");
+}
+
+static void delta_draw_complete() {
+    send_delta_frame(0);
+}
+
+static displayport_vtable_t delta_driver = {
+    .draw_character = &delta_draw_character,
+    .draw_string = &delta_draw_string,
+    .clear_screen = &delta_clear_screen,
+    .draw_complete = &delta_draw_complete,
+    .set_options = &delta_set_options,
+};
+
 static void rx_msp_callback(msp_msg_t *msp_message)
 {
     // Process a received MSP message from FC and decide whether to send it to the PTY (DJI) or UDP port (MSP-OSD on Goggles)
     DEBUG_PRINT("FC->AU MSP msg %d with data len %d \n", msp_message->cmd, msp_message->size);
-    if(msp_message->cmd == MSP_CMD_DISPLAYPORT) {
+    if(msp_message->cmd == MSP_CMD_DISPLAYPORT && delta_osd) {
+        // Apply the message to our own copy of the screen, the driver sends the changes once the frame is drawn.
+        mark_frame_pending();
+        displayport_process_message(&delta_driver, msp_message);
+    } else if(msp_message->cmd == MSP_CMD_DISPLAYPORT) {
         // This was an MSP DisplayPort message, so buffer it until we get a whole frame.
-        if(fb_cursor > sizeof(frame_buffer)) {
-            printf("Exhausted frame buffer! Resetting...\n");
+        uint8_t *data;
+        uint16_t size = msp_message_bytes(msp_message, &data);
+        if(fb_cursor + size > sizeof(frame_buffer)) {
+            // Send what we have as the first part of the frame. Nothing is drawn until the goggles see the draw command.
+            msp_link_send(&msp_link, socket_fd, MSP_LINK_FLAG_MORE, frame_buffer, fb_cursor);
+            DEBUG_PRINT("FLUSH! wrote %d bytes\n", fb_cursor);
             fb_cursor = 0;
-            return;
         }
-        uint16_t size = msp_data_from_msg(message_buffer, msp_message);
-        memcpy(&frame_buffer[fb_cursor], message_buffer, size);
+        memcpy(&frame_buffer[fb_cursor], data, size);
         fb_cursor += size;
         if(msp_message->payload[0] == 4) {
             // Once we have a whole frame of data, send it to the goggles.
-            write(socket_fd, frame_buffer, fb_cursor);
+            msp_link_send(&msp_link, socket_fd, 0, frame_buffer, fb_cursor);
             DEBUG_PRINT("DRAW! wrote %d bytes\n", fb_cursor);
             fb_cursor = 0;
+            frame_pending = 0;
+        } else {
+            mark_frame_pending();
         }
     } else {
-        uint16_t size = msp_data_from_msg(message_buffer, msp_message);
+        uint8_t *data;
+        uint16_t size = msp_message_bytes(msp_message, &data);
         // This isn't an MSP DisplayPort message, so send it to either DJI directly or to the cache.
         if(serial_passthrough) {
-            write(pty_fd, message_buffer, size);
+            write(pty_fd, data, size);
         } else {
             // Serial passthrough is off, so cache the response we got.
             if(cache_msp_message(msp_message)) {
@@ -132,21 +238,42 @@ static void rx_msp_callback(msp_msg_t *msp_message)
                 // this means DJI is waiting for it, so send it over
                 DEBUG_PRINT("DJI was waiting, got msg %d\n", msp_message->cmd);
                 for (int i = 0; i < size; i++) {
-                    DEBUG_PRINT("%02X ", message_buffer[i]);
+                    DEBUG_PRINT("%02X ", data[i]);
                 }
                 DEBUG_PRINT("\n");
-                write(pty_fd, message_buffer, size);
+                write(pty_fd, data, size);
             }
         }
     }
 }
 
+static void flush_partial_frame() {
+    // The FC has held this frame back for too long, have the goggles show what we have so far.
+    if(delta_osd) {
+        send_delta_frame(MSP_LINK_FLAG_PARTIAL);
+    } else {
+        msp_link_send(&msp_link, socket_fd, MSP_LINK_FLAG_PARTIAL, frame_buffer, fb_cursor);
+        DEBUG_PRINT("HOLD EXPIRED! wrote %d bytes\n", fb_cursor);
+        fb_cursor = 0;
+        frame_pending = 0;
+    }
+}
+
+static int frame_hold_remaining_ms(struct timespec *now) {
+    // how long the poll loop may sleep before the pending frame has to go out, -1 if nothing is waiting
+    if(!frame_pending || !osd_max_hold_ms) {
+        return -1;
+    }
+    int64_t held_ms = timespec_subtract_ns(now, &frame_pending_since) / 1000000;
+    return held_ms >= osd_max_hold_ms ? 0 : osd_max_hold_ms - held_ms;
+}
+
 static void tx_msp_callback(msp_msg_t *msp_message)
 {
     // We got a valid message from DJI asking for something. See if there's a response in the cache or not.
     // We can only get here if serial passthrough is off and caching is on, so no need to check again.
     DEBUG_PRINT("DJI->FC MSP msg %d with request len %d \n", msp_message->cmd, msp_message->size);
-    uint8_t send_buffer[256];
+    uint8_t send_buffer[MSP_MAX_FRAME_SIZE];
     int16_t size;
     if(0 < (size = msp_msg_from_cache(send_buffer, msp_message->cmd))) {
         // cache hit, so write the cached message straight back to DJI
@@ -159,8 +286,9 @@ static void tx_msp_callback(msp_msg_t *msp_message)
     } else {
         // cache miss, so write the DJI request to serial and wait for the FC to come back.
         DEBUG_PRINT("DJI->FC MSP CACHE MISS msg %d\n",msp_message->cmd);
-        uint16_t size = msp_data_from_msg(message_buffer, msp_message);
-        write(serial_fd, message_buffer, size);
+        uint8_t *data;
+        uint16_t size = msp_message_bytes(msp_message, &data);
+        write(serial_fd, data, size);
     }
 }
 
@@ -178,7 +306,7 @@ int main(int argc, char *argv[]) {
     int opt;
     uint8_t fast_serial = 0;
     uint8_t msp_command_number = 0;
-    while((opt = getopt(argc, argv, "fsp")) != -1){
+    while((opt = getopt(argc, argv, "fspd")) != -1){
         switch(opt){
         case 'f':
             fast_serial = 1;
@@ -186,6 +314,9 @@ int main(int argc, char *argv[]) {
         case 's':
             serial_passthrough = 0;
             break;
+        case 'd':
+            delta_osd = 1;
+            break;
         case '?':
             printf("unknown option: %c\n", optopt);
             break;
@@ -193,7 +324,7 @@ int main(int argc, char *argv[]) {
     }
 
     if((argc - optind) < 2) {
-        printf("usage: msp_displayport_mux [-f] [-s] ipaddr serial_port [pty_target]\n-s : enable serial caching\n-f : 230400 baud serial\n");
+        printf("usage: msp_displayport_mux [-f] [-s] [-d] ipaddr serial_port [pty_target]\n-s : enable serial caching\n-f : 230400 baud serial\n-d : send OSD as cell deltas\n");
         return 0;
     }
 
@@ -205,6 +336,21 @@ int main(int argc, char *argv[]) {
         serial_passthrough = 0;
     }
 
+    if(get_boolean_config_value(DELTA_OSD_KEY)) {
+        delta_osd = 1;
+    }
+
+    int fec_group_size = get_integer_config_value(FEC_GROUP_SIZE_KEY);
+    if(fec_group_size < 0) {
+        fec_group_size = 0;
+    }
+    msp_link_tx_init(&msp_link, fec_group_size, get_boolean_config_value(COMPRESS_OSD_KEY));
+
+    int max_hold_ms = get_integer_config_value(OSD_MAX_HOLD_KEY);
+    if(max_hold_ms > 0) {
+        osd_max_hold_ms = max_hold_ms;
+    }
+
     if(fast_serial == 1) {
         printf("Configured to use 230400 baud rate. \n");
     }
@@ -213,6 +359,23 @@ int main(int argc, char *argv[]) {
         printf("Configured to use serial caching. \n");
     }
 
+    if(msp_link.fec_group_size > 0) {
+        printf("Configured to send a parity packet after every %d OSD packets. \n", msp_link.fec_group_size);
+    }
+
+    if(msp_link.compress) {
+        printf("Configured to compress OSD packets. \n");
+    }
+
+    if(osd_max_hold_ms > 0) {
+        printf("Configured to flush OSD updates held for more than %d ms. \n", osd_max_hold_ms);
+    }
+
+    if(delta_osd == 1) {
+        printf("Configured to send OSD as cell deltas. \n");
+        displayport_delta_encoder_init(&delta_encoder);
+    }
+
     dji_shm_state_t dji_radio;
     memset(&dji_radio, 0, sizeof(dji_radio));
     open_dji_radio_shm(&dji_radio);
@@ -251,14 +414,14 @@ int main(int argc, char *argv[]) {
         poll_fds[0].events = POLLIN;
         poll_fds[1].events = POLLIN;
 
-        poll(poll_fds, 2, 250);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int hold_remaining_ms = frame_hold_remaining_ms(&now);
+        poll(poll_fds, 2, (hold_remaining_ms >= 0 && hold_remaining_ms < 250) ? hold_remaining_ms : 250);
         
         // We got inbound serial data, process it as MSP data.
         if (0 < (serial_data_size = read(serial_fd, serial_data, sizeof(serial_data)))) {
             DEBUG_PRINT("RECEIVED data! length %d\n", serial_data_size);
-            for (ssize_t i = 0; i < serial_data_size; i++) {
-                msp_process_data(rx_msp_state, serial_data[i]);
-            }
+            msp_process_buffer(rx_msp_state, serial_data, serial_data_size);
         }
         // We got data from DJI (the pty), so see what to do next:
         if(0 < (serial_data_size = read(pty_fd, serial_data, sizeof(serial_data)))) {
@@ -273,12 +436,13 @@ int main(int argc, char *argv[]) {
             } else {
                 // Otherwise, queue it up for processing by the MSP layer.
                 DEBUG_PRINT("SEND data to MSP buffer! length %d\n", serial_data_size);
-                for (ssize_t i = 0; i < serial_data_size; i++) {
-                    msp_process_data(tx_msp_state, serial_data[i]);
-                }
+                msp_process_buffer(tx_msp_state, serial_data, serial_data_size);
             }
         }
         clock_gettime(CLOCK_MONOTONIC, &now);
+        if(frame_hold_remaining_ms(&now) == 0) {
+            flush_partial_frame();
+        }
         if(timespec_subtract_ns(&now, &last) > (NSEC_PER_SEC / 2)) {
             // More than 500ms have elapsed, let's go ahead and send a data frame
             clock_gettime(CLOCK_MONOTONIC, &last);
@@ -0,0 +1,242 @@
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msp_link.h"
+#include "../util/rle.h"
+
+static uint32_t monotonic_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static uint16_t new_session() {
+    // Has to differ from the last boot's, and the air unit boots to the same uptime every time.
+    uint16_t session = 0;
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0 || read(fd, &session, sizeof(session)) != sizeof(session)) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        session = (uint16_t)(now.tv_nsec ^ getpid());
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return session;
+}
+
+static void fec_reset(msp_link_fec_t *fec, uint16_t base_seq) {
+    memset(fec->data, 0, fec->max_len);
+    memset(&fec->parity, 0, sizeof(fec->parity));
+    fec->base_seq = base_seq;
+    fec->count = 0;
+    fec->max_len = 0;
+}
+
+static void fec_add(msp_link_fec_t *fec, msp_link_header_t *header, uint8_t *payload, uint16_t len) {
+    fec->parity.flags ^= header->flags;
+    fec->parity.len ^= len;
+    fec->parity.timestamp_ms ^= header->timestamp_ms;
+    for (uint16_t i = 0; i < len; i++) {
+        fec->data[i] ^= payload[i];
+    }
+    if (len > fec->max_len) {
+        fec->max_len = len;
+    }
+    fec->count++;
+}
+
+void msp_link_tx_init(msp_link_tx_t *tx, uint8_t fec_group_size, uint8_t compress) {
+    memset(tx, 0, sizeof(msp_link_tx_t));
+    tx->session = new_session();
+    tx->compress = compress;
+    if (fec_group_size > MSP_LINK_MAX_FEC_GROUP_SIZE) {
+        fec_group_size = MSP_LINK_MAX_FEC_GROUP_SIZE;
+    }
+    tx->fec_group_size = fec_group_size;
+}
+
+static int send_parity(msp_link_tx_t *tx, int fd) {
+    msp_link_header_t header;
+    header.magic = MSP_LINK_MAGIC;
+    header.flags = MSP_LINK_FLAG_PARITY;
+    header.session = tx->session;
+    header.seq = tx->fec.base_seq;
+    header.timestamp_ms = monotonic_ms();
+    tx->fec.parity.count = tx->fec.count;
+    struct iovec iov[3] = {
+        { .iov_base = &header, .iov_len = sizeof(header) },
+        { .iov_base = &tx->fec.parity, .iov_len = sizeof(tx->fec.parity) },
+        { .iov_base = tx->fec.data, .iov_len = tx->fec.max_len },
+    };
+    return writev(fd, iov, 3);
+}
+
+int msp_link_send(msp_link_tx_t *tx, int fd, uint8_t flags, uint8_t *payload, uint16_t len) {
+    if (tx->compress && len > 1) {
+        // only worth it if it actually comes out smaller
+        uint32_t compressed_len = rle_encode(tx->compressed, len - 1, payload, len);
+        if (compressed_len > 0) {
+            payload = tx->compressed;
+            len = compressed_len;
+            flags |= MSP_LINK_FLAG_COMPRESSED;
+        }
+    }
+    msp_link_header_t header;
+    header.magic = MSP_LINK_MAGIC;
+    header.flags = flags;
+    header.session = tx->session;
+    header.seq = tx->seq++;
+    header.timestamp_ms = monotonic_ms();
+    struct iovec iov[2] = {
+        { .iov_base = &header, .iov_len = sizeof(header) },
+        { .iov_base = payload, .iov_len = len },
+    };
+    int retval = writev(fd, iov, 2);
+    if (tx->fec_group_size) {
+        if (tx->fec.count == 0) {
+            fec_reset(&tx->fec, header.seq);
+        }
+        fec_add(&tx->fec, &header, payload, len);
+        if (tx->fec.count == tx->fec_group_size) {
+            send_parity(tx, fd);
+            fec_reset(&tx->fec, tx->seq);
+        }
+    }
+    return retval;
+}
+
+static int accept_sequence(msp_link_rx_t *rx, uint16_t seq, uint32_t timestamp_ms) {
+    int16_t seq_delta = (int16_t)(seq - rx->last_seq);
+    int32_t timestamp_delta = (int32_t)(timestamp_ms - rx->last_timestamp_ms);
+    if (rx->synced && seq_delta <= 0) {
+        if (timestamp_delta > 0) {
+            // sequence went back while time moved forward, so the sender restarted: resync to it
+            rx->synced = 0;
+        } else if (seq_delta == 0) {
+            rx->stats.duplicated++;
+            return 0;
+        } else {
+            // an older frame turned up after a newer one was drawn, showing it now would step the OSD backwards
+            rx->stats.reordered++;
+            return 0;
+        }
+    }
+    if (rx->synced && seq_delta > 1) {
+        rx->stats.lost += seq_delta - 1;
+    }
+    rx->synced = 1;
+    rx->last_seq = seq;
+    rx->last_timestamp_ms = timestamp_ms;
+    rx->stats.received++;
+    return 1;
+}
+
+static void fec_receive_data(msp_link_rx_t *rx, msp_link_header_t *header, uint8_t *payload, uint16_t len) {
+    if (!rx->fec_group_size || len > MSP_LINK_MAX_PAYLOAD) {
+        return;
+    }
+    int16_t offset = (int16_t)(header->seq - rx->fec.base_seq);
+    if (offset < 0) {
+        // belongs to a group we already gave up on
+        return;
+    }
+    if (offset >= rx->fec_group_size) {
+        // the parity for the current group never came, move on to the group this datagram is in
+        fec_reset(&rx->fec, rx->fec.base_seq + (offset / rx->fec_group_size) * rx->fec_group_size);
+        rx->fec_received = 0;
+        offset %= rx->fec_group_size;
+    }
+    if (rx->fec_received & (1 << offset)) {
+        return;
+    }
+    rx->fec_received |= 1 << offset;
+    fec_add(&rx->fec, header, payload, len);
+}
+
+static int fec_receive_parity(msp_link_rx_t *rx, msp_link_header_t *header, uint8_t *buf, int len, uint8_t **payload) {
+    // Rebuild the one data datagram missing from the group, if exactly one is missing, and sequence it like any other.
+    if (len < (int)sizeof(msp_link_parity_t)) {
+        return -1;
+    }
+    msp_link_parity_t *parity = (msp_link_parity_t *)buf;
+    uint8_t *parity_data = buf + sizeof(msp_link_parity_t);
+    uint16_t parity_len = len - sizeof(msp_link_parity_t);
+    uint8_t group_size = parity->count;
+    if (group_size == 0 || group_size > MSP_LINK_MAX_FEC_GROUP_SIZE) {
+        return -1;
+    }
+    int retval = -1;
+    if (rx->fec_group_size == group_size && rx->fec.base_seq == header->seq && rx->fec.count == group_size - 1) {
+        uint8_t missing = 0;
+        while (rx->fec_received & (1 << missing)) {
+            missing++;
+        }
+        uint16_t rebuilt_seq = header->seq + missing;
+        uint32_t rebuilt_timestamp_ms = rx->fec.parity.timestamp_ms ^ parity->timestamp_ms;
+        uint16_t rebuilt_len = rx->fec.parity.len ^ parity->len;
+        if (rx->synced && (int16_t)(rebuilt_seq - rx->last_seq) < 0) {
+            // Too late: something newer already went to the parser, and this one would step the OSD backwards.
+            // Smaller groups bring the parity sooner, so fewer rebuilt datagrams are stale by the time it arrives.
+            rx->stats.recovered++;
+        } else if (rebuilt_len <= parity_len && rebuilt_len <= MSP_LINK_MAX_PAYLOAD) {
+            for (uint16_t i = 0; i < rebuilt_len; i++) {
+                rx->recovered[i] = rx->fec.data[i] ^ parity_data[i];
+            }
+            if (accept_sequence(rx, rebuilt_seq, rebuilt_timestamp_ms)) {
+                rx->stats.recovered++;
+                rx->payload_flags = rx->fec.parity.flags ^ parity->flags;
+                *payload = rx->recovered;
+                retval = rebuilt_len;
+            }
+        }
+    }
+    rx->fec_group_size = group_size;
+    fec_reset(&rx->fec, header->seq + group_size);
+    rx->fec_received = 0;
+    return retval;
+}
+
+static int receive_datagram(msp_link_rx_t *rx, uint8_t *buf, int len, uint8_t **payload) {
+    if (len < (int)sizeof(msp_link_header_t) || buf[0] != MSP_LINK_MAGIC) {
+        rx->payload_flags = 0;
+        *payload = buf;
+        return len;
+    }
+    msp_link_header_t *header = (msp_link_header_t *)buf;
+    buf += sizeof(msp_link_header_t);
+    len -= sizeof(msp_link_header_t);
+    if (header->session != rx->session) {
+        // the sender restarted, nothing it sent before can be compared with what it sends now
+        rx->synced = 0;
+        rx->session = header->session;
+        rx->fec_group_size = 0;
+        rx->fec_received = 0;
+        fec_reset(&rx->fec, header->seq);
+    }
+    if (header->flags & MSP_LINK_FLAG_PARITY) {
+        return fec_receive_parity(rx, header, buf, len, payload);
+    }
+    fec_receive_data(rx, header, buf, len);
+    if (!accept_sequence(rx, header->seq, header->timestamp_ms)) {
+        return -1;
+    }
+    rx->payload_flags = header->flags;
+    *payload = buf;
+    return len;
+}
+
+int msp_link_receive(msp_link_rx_t *rx, uint8_t *buf, int len, uint8_t **payload) {
+    // Returns the payload length and points payload at it, or -1 if the datagram should be dropped.
+    // Datagrams without a header come from an older air unit and are passed through untouched.
+    len = receive_datagram(rx, buf, len, payload);
+    if (len > 0 && (rx->payload_flags & MSP_LINK_FLAG_COMPRESSED)) {
+        len = rle_decode(rx->decompressed, sizeof(rx->decompressed), *payload, len);
+        *payload = rx->decompressed;
+    }
+    return len;
+}
@@ -0,0 +1,79 @@
+#include <stdint.h>
+
+// Framing for the MSP_PORT UDP stream from the air unit. Every datagram starts with an msp_link_header_t,
+// which lets the goggles drop lost, duplicated and late datagrams before they reach the MSP parser.
+
+#define MSP_LINK_MAGIC 0xA5
+
+#define MSP_LINK_FLAG_PARITY 0x01 // msp_link_parity_t and XOR parity of the group starting at seq, not a frame
+#define MSP_LINK_FLAG_COMPRESSED 0x02 // payload is RLE encoded, see util/rle.h
+#define MSP_LINK_FLAG_MORE 0x04 // more datagrams of the same OSD frame follow
+#define MSP_LINK_FLAG_PARTIAL 0x08 // the air unit stopped waiting for the FC to finish the frame, draw what has arrived
+
+// Largest payload that keeps a datagram, parity included, inside a 1500 byte MTU once IP and UDP headers are added.
+// Senders split frames at this size rather than relying on IP fragmentation, where losing any fragment loses the frame.
+#define MSP_LINK_MAX_CHUNK_SIZE 1400
+
+#define MSP_LINK_MAX_PAYLOAD 8192
+#define MSP_LINK_MAX_FEC_GROUP_SIZE 16
+#define MSP_LINK_MAX_DATAGRAM_SIZE (sizeof(msp_link_header_t) + sizeof(msp_link_parity_t) + MSP_LINK_MAX_PAYLOAD)
+
+typedef struct msp_link_header_s {
+    uint8_t magic;
+    uint8_t flags;
+    uint16_t session; // picked at random each time the sender starts, seq and timestamp_ms start over when it changes
+    uint16_t seq;
+    uint32_t timestamp_ms; // sender CLOCK_MONOTONIC, only compared against other timestamps from the same sender
+} __attribute__((packed)) msp_link_header_t;
+
+// Parity datagrams carry the XOR of every data datagram in their group, so any single lost one can be rebuilt.
+// Shorter payloads are XORed as if zero padded to the longest.
+typedef struct msp_link_parity_s {
+    uint8_t count; // data datagrams in the group
+    uint8_t flags;
+    uint16_t len;
+    uint32_t timestamp_ms;
+} __attribute__((packed)) msp_link_parity_t;
+
+typedef struct msp_link_stats_s {
+    uint32_t received;
+    uint32_t lost;
+    uint32_t reordered;
+    uint32_t duplicated;
+    uint32_t recovered;
+} msp_link_stats_t;
+
+typedef struct msp_link_fec_s {
+    uint16_t base_seq;
+    uint8_t count;
+    uint16_t max_len;
+    msp_link_parity_t parity;
+    uint8_t data[MSP_LINK_MAX_PAYLOAD];
+} msp_link_fec_t;
+
+typedef struct msp_link_tx_s {
+    uint16_t session;
+    uint16_t seq;
+    uint8_t fec_group_size; // 0 disables parity
+    uint8_t compress;
+    msp_link_fec_t fec;
+    uint8_t compressed[MSP_LINK_MAX_PAYLOAD];
+} msp_link_tx_t;
+
+typedef struct msp_link_rx_s {
+    uint8_t synced;
+    uint16_t session;
+    uint16_t last_seq;
+    uint32_t last_timestamp_ms;
+    uint8_t payload_flags; // flags of the datagram msp_link_receive last returned a payload for
+    msp_link_stats_t stats;
+    uint8_t fec_group_size; // learned from parity datagrams, 0 until the first one arrives
+    uint32_t fec_received; // bitmask of the data datagrams seen in the current group
+    msp_link_fec_t fec;
+    uint8_t recovered[MSP_LINK_MAX_PAYLOAD];
+    uint8_t decompressed[MSP_LINK_MAX_PAYLOAD];
+} msp_link_rx_t;
+
+void msp_link_tx_init(msp_link_tx_t *tx, uint8_t fec_group_size, uint8_t compress);
+int msp_link_send(msp_link_tx_t *tx, int fd, uint8_t flags, uint8_t *payload, uint16_t len);
+int msp_link_receive(msp_link_rx_t *rx, uint8_t *buf, int len, uint8_t **payload);
@@ -0,0 +1,24 @@
+#include "../msp/msp.h"
+#include "../msp/msp_displayport.h"
+#include "../msp/msp_displayport_delta.h"
+#include "msp_link.h"
+#include "msp_link_displayport.h"
+
+int msp_link_receive_displayport(msp_link_rx_t *rx, msp_state_t *msp_state, displayport_vtable_t *display_driver, uint8_t *buf, int len) {
+    // Drop stale datagrams from the air unit, then hand the rest to the decoder matching their format.
+    // Returns the payload length handed on, or -1 if the datagram was dropped.
+    uint8_t *payload;
+    if (0 > (len = msp_link_receive(rx, buf, len, &payload))) {
+        return -1;
+    }
+    if (len > 0 && payload[0] == DISPLAYPORT_DELTA_MAGIC) {
+        displayport_delta_apply(display_driver, payload, len);
+    } else {
+        msp_process_buffer(msp_state, payload, len);
+        if (rx->payload_flags & MSP_LINK_FLAG_PARTIAL) {
+            // no draw command is coming for this frame, delta packets always carry their own
+            display_driver->draw_complete();
+        }
+    }
+    return len;
+}
@@ -0,0 +1,6 @@
+#include <stdint.h>
+
+// Receive side of the MSP_PORT link for the DisplayPort frontends, shared so each link protocol change is made once.
+// Needs msp/msp.h, msp/msp_displayport.h and net/msp_link.h included first.
+
+int msp_link_receive_displayport(msp_link_rx_t *rx, msp_state_t *msp_state, displayport_vtable_t *display_driver, uint8_t *buf, int len);
@@ -2,4 +2,5 @@
 
 void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_handle);
 void osd_disable();
-void osd_enable();
\ No newline at end of file
+void osd_enable();
+uint32_t osd_skipped_frame_count();
\ No newline at end of file
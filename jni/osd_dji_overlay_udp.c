@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // recvmmsg
 #include <stdio.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -15,16 +16,25 @@
 #include <time.h>
 #include <linux/input.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
 
 #include "hw/dji_display.h"
 #include "hw/dji_radio_shm.h"
 #include "hw/dji_services.h"
 #include "json/osd_config.h"
+#include "net/msp_link.h"
 #include "net/network.h"
 #include "net/data_protocol.h"
 #include "msp/msp.h"
 #include "msp/msp_displayport.h"
+#include "net/msp_link_displayport.h"
+#include "font/font_registry.h"
+#include "font/glyph_spans.h"
+#include "util/blit.h"
 #include "util/fs_util.h"
+#include "util/osd_grid.h"
+#include "util/time_util.h"
 
 #define MSP_PORT 7654
 #define DATA_PORT 7655
@@ -64,9 +74,6 @@
 ( (((data) >> 24) & 0x000000FF) | (((data) >>  8) & 0x0000FF00) | \
   (((data) <<  8) & 0x00FF0000) | (((data) << 24) & 0xFF000000) )
 
-#define MAX_DISPLAY_X 60
-#define MAX_DISPLAY_Y 22
-
 typedef struct display_info_s {
     uint8_t char_width;
     uint8_t char_height;
@@ -74,16 +81,21 @@ typedef struct display_info_s {
     uint8_t font_height;
     uint16_t x_offset;
     uint16_t y_offset;
-    void *font_page_1;
-    void *font_page_2;
+    const void *font_page_1;
+    const void *font_page_2;
+    const glyph_spans_t *spans_page_1; // where each glyph has ink, NULL to draw whole cells
+    const glyph_spans_t *spans_page_2;
 } display_info_t;
 
 static volatile sig_atomic_t quit = 0;
 static dji_display_state_t *dji_display;
-static uint16_t msp_character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y];
-static uint16_t msp_render_character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y];
-static uint16_t overlay_character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y];
+static osd_grid_t msp_character_map; // the last completed frame, what gets published to the render thread
+static osd_grid_t msp_pending_map; // the frame the FC is still drawing
+static uint8_t msp_pending_cleared = 0;
+static osd_grid_t msp_render_character_map; // FakeHD layout, owned by the render thread
+static osd_grid_t overlay_character_map;
 static displayport_vtable_t *display_driver;
+static msp_link_rx_t msp_link;
 static uint8_t which_fb = 0;
 
 static display_info_t sd_display_info = {
@@ -140,6 +152,26 @@ static display_info_t *current_display_info;
 
 int event_fd;
 
+/* Frame handoff: the I/O thread publishes completed frames, the render thread picks up the newest without either waiting on the other */
+
+typedef struct osd_frame_s {
+    enum display_mode_s display_mode;
+    display_info_t *display_info;
+    uint32_t msp_clear_count; // so the render thread notices clears in frames it never picked up
+    osd_grid_t msp_character_map;
+    osd_grid_t overlay_character_map;
+} osd_frame_t;
+
+#define FRAME_SLOT_FRESH 0x80
+
+// Three slots, one being written, one being rendered and one waiting in between, swapped by index.
+static osd_frame_t frame_slots[3];
+static uint8_t publish_slot = 0; // owned by the I/O thread
+static uint8_t ready_slot = 1; // exchanged atomically, FRAME_SLOT_FRESH set until the render thread takes it
+static uint8_t render_slot = 2; // owned by the render thread
+static osd_frame_t *render_frame = &frame_slots[2];
+static uint32_t msp_clear_count = 0;
+
 /* FakeHD: spread characters for a small OSD across the whole screen */
 
 #define FAKEHD_ENABLE_KEY "fakehd_enable"
@@ -161,6 +193,7 @@ static void check_is_fakehd_enabled()
 
 static void fakehd_map_sd_character_map_to_hd()
 {
+    const osd_grid_t *sd_map = &render_frame->msp_character_map;
     int render_x = 0;
     int render_y = 0;
     for (int y = 15; y >= 0; y--)
@@ -168,12 +201,12 @@ static void fakehd_map_sd_character_map_to_hd()
         for (int x = 29; x >= 0; x--)
         {
             // skip if it's not a character
-            if (msp_character_map[x][y] != 0)
+            if (OSD_GRID_CELL(sd_map, x, y) != 0)
             {
                 // if current element is fly min icon
                 // record the current position as the 'trigger' position
                 if (fakehd_trigger_x == 99 &&
-                msp_character_map[x][y] == 0x9c)
+                OSD_GRID_CELL(sd_map, x, y) == 0x9c)
                 {
                     DEBUG_PRINT("found fakehd triggger \n");
                     fakehd_trigger_x = x;
@@ -185,7 +218,7 @@ static void fakehd_map_sd_character_map_to_hd()
                 // timer/battery symbols
                 if (
                     fakehd_trigger_x != 99 &&
-                    msp_character_map[fakehd_trigger_x][fakehd_trigger_y] != 0x9c
+                    OSD_GRID_CELL(sd_map, fakehd_trigger_x, fakehd_trigger_y) != 0x9c
                 )
                 {
                     render_x = x + 15;
@@ -222,64 +255,337 @@ static void fakehd_map_sd_character_map_to_hd()
                         render_x += 1;
                     }
                 }
-                msp_render_character_map[render_x][render_y] = msp_character_map[x][y];
+                OSD_GRID_CELL(&msp_render_character_map, render_x, render_y) = OSD_GRID_CELL(sd_map, x, y);
             }
         }
     }
 }
 
-/* Character map helpers */
+/* Mask fonts: glyphs kept as one byte coverage masks and coloured from config while drawing, see blit_rgba_to_mask */
+
+#define TEXT_COLOR_KEY "text_color"
+#define OUTLINE_COLOR_KEY "outline_color"
+static uint8_t font_is_mask = 0;
+static uint32_t font_mask_palette[256];
+
+static int parse_color(const char *value, uint32_t *rgb) {
+    // "#RRGGBB" or "RRGGBB"
+    if (value == NULL) {
+        return -1;
+    }
+    if (value[0] == '#') {
+        value++;
+    }
+    char *end;
+    unsigned long parsed = strtoul(value, &end, 16);
+    if (end - value != 6 || *end != '\0') {
+        return -1;
+    }
+    *rgb = parsed;
+    return 0;
+}
 
-static void draw_character(display_info_t *display_info, uint16_t character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y], uint32_t x, uint32_t y, uint16_t c)
+static void check_font_colors()
 {
-    if ((x > (display_info->char_width - 1)) || (y > (display_info->char_height - 1))) {
+    uint32_t text_rgb;
+    uint32_t outline_rgb = 0x000000;
+    if (parse_color(get_string_config_value(TEXT_COLOR_KEY), &text_rgb) < 0) {
+        DEBUG_PRINT("using the colours in the font\n");
         return;
     }
-    character_map[x][y] = c;
+    parse_color(get_string_config_value(OUTLINE_COLOR_KEY), &outline_rgb);
+    DEBUG_PRINT("using mask fonts, text %06x outline %06x\n", text_rgb, outline_rgb);
+    blit_build_mask_palette(font_mask_palette, text_rgb, outline_rgb);
+    font_is_mask = 1;
 }
 
 static void msp_draw_character(uint32_t x, uint32_t y, uint16_t c) {
-    draw_character(current_display_info, msp_character_map, x, y, c);
+    osd_grid_set(&msp_pending_map, x, y, c);
+}
+
+static void msp_draw_string(uint32_t x, uint32_t y, uint8_t *string, uint16_t len, uint8_t page) {
+    osd_grid_blit_row(&msp_pending_map, x, y, string, len, page);
 }
 
+/* Damage tracking: whether this frame wrote to the buffer at all, a buffer that already held the frame skips the cache clean */
+
+static uint8_t frame_dirty;
+
 /* Main rendering function: take a character_map and a display_info and draw it into a framebuffer */
 
-static void draw_character_map(display_info_t *display_info, void* restrict fb_addr, uint16_t character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y]) {
+static void draw_cell_rows(display_info_t *display_info, void* restrict fb_addr, uint32_t x, uint32_t y, uint16_t c, uint32_t top, uint32_t bottom) {
+    // Draw only the glyph rows which land on framebuffer rows [top, bottom).
+    // The cell must already be cleared, only the parts of the glyph with ink are written.
+    const void* restrict font = display_info->font_page_1;
+    const glyph_spans_t *spans = display_info->spans_page_1;
+    if (c > 255) {
+        c = c & 0xFF;
+        if (display_info->font_page_2 != NULL) {
+            // fall back to writing page 1 chars if we don't have a page 2 font
+            font = display_info->font_page_2;
+            spans = display_info->spans_page_2;
+        }
+    }
+    uint32_t pixel_x = (x * display_info->font_width) + display_info->x_offset;
+    uint32_t pixel_y = (y * display_info->font_height) + display_info->y_offset;
+    uint32_t first_row = top > pixel_y ? top - pixel_y : 0;
+    uint32_t last_row = bottom < pixel_y + display_info->font_height ? bottom - pixel_y : display_info->font_height;
+    const glyph_span_t *row_spans = NULL;
+    if (spans != NULL) {
+        if (first_row < spans->top[c]) {
+            first_row = spans->top[c];
+        }
+        if (last_row > spans->bottom[c]) {
+            last_row = spans->bottom[c];
+        }
+        row_spans = &spans->rows[c * display_info->font_height];
+    }
+    uint32_t font_bytes_per_pixel = font_is_mask ? 1 : BYTES_PER_PIXEL;
+    uint32_t font_offset = (((display_info->font_height * display_info->font_width) * font_bytes_per_pixel) * c) + (first_row * display_info->font_width * font_bytes_per_pixel);
+    uint32_t target_offset = ((pixel_x * BYTES_PER_PIXEL) + ((pixel_y + first_row) * WIDTH * BYTES_PER_PIXEL));
+    for(uint32_t gy = first_row; gy < last_row; gy++) {
+        uint32_t start = row_spans != NULL ? row_spans[gy].start : 0;
+        uint32_t end = row_spans != NULL ? row_spans[gy].end : display_info->font_width;
+        uint8_t *target = (uint8_t *)fb_addr + target_offset + start * BYTES_PER_PIXEL;
+        const uint8_t *source = (const uint8_t *)font + font_offset + start * font_bytes_per_pixel;
+        if (font_is_mask) {
+            blit_mask_to_dji(target, source, end - start, font_mask_palette);
+        } else {
+            // Fonts are already in the DJI pixel format (see load_font), so each glyph row is a straight copy.
+            memcpy(target, source, (end - start) * BYTES_PER_PIXEL);
+        }
+        font_offset += display_info->font_width * font_bytes_per_pixel;
+        target_offset += WIDTH * BYTES_PER_PIXEL;
+    }
+}
+
+static void draw_cell(display_info_t *display_info, void* restrict fb_addr, uint32_t x, uint32_t y, uint16_t c) {
+    frame_dirty = 1;
+    draw_cell_rows(display_info, fb_addr, x, y, c, 0, HEIGHT);
+}
+
+static void clear_cell(display_info_t *display_info, void *fb_addr, uint32_t x, uint32_t y) {
+    uint32_t pixel_x = (x * display_info->font_width) + display_info->x_offset;
+    uint32_t pixel_y = (y * display_info->font_height) + display_info->y_offset;
+    uint32_t target_offset = ((pixel_x * BYTES_PER_PIXEL) + (pixel_y * WIDTH * BYTES_PER_PIXEL));
+    frame_dirty = 1;
+    for(uint8_t gy = 0; gy < display_info->font_height; gy++) {
+        // DJI has a backwards alpha channel - FF is transparent, 00 is opaque.
+        memset((uint8_t *)fb_addr + target_offset, 0xFF, display_info->font_width * BYTES_PER_PIXEL);
+        target_offset += WIDTH * BYTES_PER_PIXEL;
+    }
+}
+
+static void draw_character_map_rows(display_info_t *display_info, void* restrict fb_addr, const osd_grid_t *character_map, uint32_t top, uint32_t bottom) {
+    // Draw the parts of a character map which land on framebuffer rows [top, bottom), without marking the frame dirty.
     if (display_info->font_page_1 == NULL) {
         // give up if we don't have a font loaded
         return;
     }
-    void *font_page_2 = display_info->font_page_2 == NULL ? display_info->font_page_1 : display_info->font_page_2;
-    void* restrict font;
-    for(int y = 0; y < display_info->char_height; y++) {
+    uint32_t grid_bottom = display_info->y_offset + display_info->char_height * display_info->font_height;
+    if (bottom <= display_info->y_offset || top >= grid_bottom) {
+        return;
+    }
+    uint32_t y0 = top > display_info->y_offset ? (top - display_info->y_offset) / display_info->font_height : 0;
+    uint32_t y1 = bottom < grid_bottom ? (bottom - display_info->y_offset - 1) / display_info->font_height : display_info->char_height - 1u;
+    for(uint32_t y = y0; y <= y1; y++) {
+        const uint16_t *row = OSD_GRID_ROW(character_map, y);
         for(int x = 0; x < display_info->char_width; x++) {
-            uint16_t c = character_map[x][y];
+            uint16_t c = row[x];
             if (c != 0) {
-                font = display_info->font_page_1;
-                if (c > 255) {
-                    c = c & 0xFF;
-                    font = font_page_2;
+                draw_cell_rows(display_info, fb_addr, x, y, c, top, bottom);
+            }
+        }
+    }
+}
+
+/* Band rendering: full redraws split the screen into horizontal bands which are drawn in parallel */
+
+// One per core on the goggles, the render thread draws band 0 itself. band_bench shows bands past the core count
+// only add wakeups, a full redraw doesn't get any faster once every core has a band.
+#define RENDER_BAND_COUNT 2
+
+typedef struct band_job_s {
+    void *fb_addr;
+    display_info_t *msp_info;
+    const osd_grid_t *msp_map;
+    const osd_grid_t *overlay_map;
+} band_job_t;
+
+static band_job_t band_job;
+static pthread_t band_workers[RENDER_BAND_COUNT - 1];
+static uint8_t band_workers_started = 0;
+static uint8_t band_workers_quit = 0;
+static uint32_t band_generation = 0;
+static uint8_t bands_remaining = 0;
+static pthread_mutex_t band_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done_cond = PTHREAD_COND_INITIALIZER;
+
+static void draw_band(uint8_t band) {
+    uint32_t top = band * HEIGHT / RENDER_BAND_COUNT;
+    uint32_t bottom = (band + 1) * HEIGHT / RENDER_BAND_COUNT;
+    // DJI has a backwards alpha channel - FF is transparent, 00 is opaque.
+    memset((uint8_t *)band_job.fb_addr + top * WIDTH * BYTES_PER_PIXEL, 0xFF, (bottom - top) * WIDTH * BYTES_PER_PIXEL);
+    // Each band draws MSP then overlay, so the overlay still ends up on top where the grids overlap.
+    draw_character_map_rows(band_job.msp_info, band_job.fb_addr, band_job.msp_map, top, bottom);
+    draw_character_map_rows(&overlay_display_info, band_job.fb_addr, band_job.overlay_map, top, bottom);
+}
+
+static void *band_worker(void *arg) {
+    uint8_t band = (uint8_t)(uintptr_t)arg;
+    uint32_t generation = 0;
+    pthread_mutex_lock(&band_mutex);
+    while (1) {
+        while (band_generation == generation && !band_workers_quit) {
+            pthread_cond_wait(&band_start_cond, &band_mutex);
+        }
+        if (band_workers_quit) {
+            break;
+        }
+        generation = band_generation;
+        pthread_mutex_unlock(&band_mutex);
+        draw_band(band);
+        pthread_mutex_lock(&band_mutex);
+        if (--bands_remaining == 0) {
+            pthread_cond_signal(&band_done_cond);
+        }
+    }
+    pthread_mutex_unlock(&band_mutex);
+    return NULL;
+}
+
+static void start_band_workers() {
+    for (uint8_t i = 0; i < RENDER_BAND_COUNT - 1; i++) {
+        if (0 != pthread_create(&band_workers[i], NULL, &band_worker, (void *)(uintptr_t)(i + 1))) {
+            // draw_bands draws the bands of any worker that didn't start itself
+            printf("failed to start band worker\n");
+            break;
+        }
+        band_workers_started++;
+    }
+}
+
+static void stop_band_workers() {
+    pthread_mutex_lock(&band_mutex);
+    band_workers_quit = 1;
+    pthread_cond_broadcast(&band_start_cond);
+    pthread_mutex_unlock(&band_mutex);
+    for (uint8_t i = 0; i < band_workers_started; i++) {
+        pthread_join(band_workers[i], NULL);
+    }
+    band_workers_started = 0;
+}
+
+static void draw_bands(void *fb_addr, display_info_t *msp_info, const osd_grid_t *msp_map, const osd_grid_t *overlay_map) {
+    band_job.fb_addr = fb_addr;
+    band_job.msp_info = msp_info;
+    band_job.msp_map = msp_map;
+    band_job.overlay_map = overlay_map;
+    if (band_workers_started > 0) {
+        // the mutex also publishes band_job to the workers
+        pthread_mutex_lock(&band_mutex);
+        bands_remaining = band_workers_started;
+        band_generation++;
+        pthread_cond_broadcast(&band_start_cond);
+        pthread_mutex_unlock(&band_mutex);
+    }
+    draw_band(0);
+    for (uint8_t band = band_workers_started + 1; band < RENDER_BAND_COUNT; band++) {
+        draw_band(band);
+    }
+    if (band_workers_started > 0) {
+        pthread_mutex_lock(&band_mutex);
+        while (bands_remaining > 0) {
+            pthread_cond_wait(&band_done_cond, &band_mutex);
+        }
+        pthread_mutex_unlock(&band_mutex);
+    }
+}
+
+/* Dirty cell tracking: each framebuffer remembers what it last showed, so a frame only touches the cells that changed */
+
+typedef struct fb_contents_s {
+    uint8_t valid;
+    display_info_t *display_info;
+    osd_grid_t msp_character_map;
+    osd_grid_t overlay_character_map;
+} fb_contents_t;
+
+static fb_contents_t fb_contents[DJI_DISPLAY_BUFFER_COUNT];
+// laid out like the grids, a 1 for each cell to redraw
+static uint8_t msp_dirty_map[OSD_GRID_MAX_HEIGHT * OSD_GRID_STRIDE];
+static uint8_t overlay_dirty_map[OSD_GRID_MAX_HEIGHT * OSD_GRID_STRIDE];
+
+static void mark_cells_in_rect(display_info_t *display_info, uint8_t *dirty_map, int32_t left, int32_t top, int32_t right, int32_t bottom) {
+    // Flag every cell of display_info's grid which overlaps the pixel rectangle [left, right) x [top, bottom).
+    int32_t grid_right = display_info->x_offset + display_info->char_width * display_info->font_width;
+    int32_t grid_bottom = display_info->y_offset + display_info->char_height * display_info->font_height;
+    if (right <= display_info->x_offset || bottom <= display_info->y_offset || left >= grid_right || top >= grid_bottom) {
+        return;
+    }
+    int32_t x0 = left > display_info->x_offset ? (left - display_info->x_offset) / display_info->font_width : 0;
+    int32_t y0 = top > display_info->y_offset ? (top - display_info->y_offset) / display_info->font_height : 0;
+    int32_t x1 = right < grid_right ? (right - display_info->x_offset - 1) / display_info->font_width : display_info->char_width - 1;
+    int32_t y1 = bottom < grid_bottom ? (bottom - display_info->y_offset - 1) / display_info->font_height : display_info->char_height - 1;
+    for(int32_t y = y0; y <= y1; y++) {
+        memset(dirty_map + y * OSD_GRID_STRIDE + x0, 1, x1 - x0 + 1);
+    }
+}
+
+static void mark_cells_under_cell(display_info_t *display_info, uint8_t *dirty_map, display_info_t *cell_display_info, uint32_t x, uint32_t y) {
+    int32_t left = (x * cell_display_info->font_width) + cell_display_info->x_offset;
+    int32_t top = (y * cell_display_info->font_height) + cell_display_info->y_offset;
+    mark_cells_in_rect(display_info, dirty_map, left, top, left + cell_display_info->font_width, top + cell_display_info->font_height);
+}
+
+static void draw_dirty_cells(fb_contents_t *contents, void* restrict fb_addr, const osd_grid_t *msp_map) {
+    display_info_t *msp_info = render_frame->display_info;
+    display_info_t *overlay_info = &overlay_display_info;
+    const osd_grid_t *overlay_map = &render_frame->overlay_character_map;
+    memset(msp_dirty_map, 0, sizeof(msp_dirty_map));
+    memset(overlay_dirty_map, 0, sizeof(overlay_dirty_map));
+
+    osd_grid_diff(msp_map, &contents->msp_character_map, msp_dirty_map);
+
+    // The overlay grid is not aligned with the MSP grid, so wiping an overlay cell also wipes parts of the MSP cells under it.
+    if (osd_grid_diff(overlay_map, &contents->overlay_character_map, overlay_dirty_map) > 0) {
+        for(int y = 0; y < overlay_info->char_height; y++) {
+            for(int x = 0; x < overlay_info->char_width; x++) {
+                if (overlay_dirty_map[y * OSD_GRID_STRIDE + x]) {
+                    clear_cell(overlay_info, fb_addr, x, y);
+                    mark_cells_under_cell(msp_info, msp_dirty_map, overlay_info, x, y);
                 }
-                uint32_t pixel_x = (x * display_info->font_width) + display_info->x_offset;
-                uint32_t pixel_y = (y * display_info->font_height) + display_info->y_offset;
-                uint32_t font_offset = (((display_info->font_height * display_info->font_width) * BYTES_PER_PIXEL) * c);
-                uint32_t target_offset = ((pixel_x * BYTES_PER_PIXEL) + (pixel_y * WIDTH * BYTES_PER_PIXEL));
-                for(uint8_t gy = 0; gy < display_info->font_height; gy++) {
-                    for(uint8_t gx = 0; gx < display_info->font_width; gx++) {
-                        *((uint8_t *)fb_addr + target_offset) = *(uint8_t *)((uint8_t *)font + font_offset + 2);
-                        *((uint8_t *)fb_addr + target_offset + 1) = *(uint8_t *)((uint8_t *)font + font_offset + 1);
-                        *((uint8_t *)fb_addr + target_offset + 2) = *(uint8_t *)((uint8_t *)font + font_offset);
-                        *((uint8_t *)fb_addr + target_offset + 3) = ~*(uint8_t *)((uint8_t *)font + font_offset + 3);
-                        font_offset += BYTES_PER_PIXEL;
-                        target_offset += BYTES_PER_PIXEL;
-                    }
-                    target_offset += WIDTH * BYTES_PER_PIXEL - (display_info->font_width * BYTES_PER_PIXEL);
+            }
+        }
+    }
+
+    // Likewise, redrawing an MSP cell can wipe part of an overlay glyph, which then has to go back on top.
+    for(int y = 0; y < msp_info->char_height; y++) {
+        const uint16_t *row = OSD_GRID_ROW(msp_map, y);
+        const uint8_t *dirty_row = msp_dirty_map + y * OSD_GRID_STRIDE;
+        for(int x = 0; x < msp_info->char_width; x++) {
+            if (dirty_row[x]) {
+                clear_cell(msp_info, fb_addr, x, y);
+                if (row[x] != 0 && msp_info->font_page_1 != NULL) {
+                    draw_cell(msp_info, fb_addr, x, y, row[x]);
                 }
-                DEBUG_PRINT("%c", c > 31 ? c : 20);
+                mark_cells_under_cell(overlay_info, overlay_dirty_map, msp_info, x, y);
+            }
+        }
+    }
+
+    if (overlay_info->font_page_1 == NULL) {
+        return;
+    }
+    for(int y = 0; y < overlay_info->char_height; y++) {
+        const uint16_t *row = OSD_GRID_ROW(overlay_map, y);
+        const uint8_t *dirty_row = overlay_dirty_map + y * OSD_GRID_STRIDE;
+        for(int x = 0; x < overlay_info->char_width; x++) {
+            if (dirty_row[x] && row[x] != 0) {
+                draw_cell(overlay_info, fb_addr, x, y, row[x]);
             }
-            DEBUG_PRINT(" ");
         }
-        DEBUG_PRINT("\n");
     }
 }
 
@@ -287,179 +593,333 @@ static void clear_framebuffer() {
     void *fb_addr = dji_display_get_fb_address(dji_display, which_fb);
     // DJI has a backwards alpha channel - FF is transparent, 00 is opaque.
     memset(fb_addr, 0x000000FF, WIDTH * HEIGHT * BYTES_PER_PIXEL);
+    frame_dirty = 1;
+    fb_contents[which_fb].valid = 0;
 }
 
 static void draw_screen() {
     void *fb_addr = dji_display_get_fb_address(dji_display, which_fb);
-    // DJI has a backwards alpha channel - FF is transparent, 00 is opaque.
-    memset(fb_addr, 0x000000FF, WIDTH * HEIGHT * BYTES_PER_PIXEL);
+    fb_contents_t *contents = &fb_contents[which_fb];
+    display_info_t *display_info = render_frame->display_info;
+    const osd_grid_t *msp_map = &render_frame->msp_character_map;
 
     if (fakehd_enabled) {
         fakehd_map_sd_character_map_to_hd();
-        draw_character_map(current_display_info, fb_addr, msp_render_character_map);
+        msp_map = &msp_render_character_map;
+    }
+
+    if (contents->valid && contents->display_info == display_info) {
+        draw_dirty_cells(contents, fb_addr, msp_map);
     } else {
-        draw_character_map(current_display_info, fb_addr, msp_character_map);
+        // Layout changed or the buffer was never drawn, so start again from a blank buffer.
+        frame_dirty = 1;
+        draw_bands(fb_addr, display_info, msp_map, &render_frame->overlay_character_map);
     }
-    draw_character_map(&overlay_display_info, fb_addr, overlay_character_map);
+
+    contents->valid = 1;
+    contents->display_info = display_info;
+    osd_grid_copy(&contents->msp_character_map, msp_map);
+    osd_grid_copy(&contents->overlay_character_map, &render_frame->overlay_character_map);
 }
 
 static void clear_overlay() {
-    memset(overlay_character_map, 0, sizeof(overlay_character_map));
+    osd_grid_clear(&overlay_character_map);
 }
 
 static void msp_clear_screen() {
-    memset(msp_character_map, 0, sizeof(msp_character_map));
-    memset(msp_render_character_map, 0, sizeof(msp_render_character_map));
+    osd_grid_clear(&msp_pending_map);
+    msp_pending_cleared = 1;
+}
+
+/* Frame skipping: flight controllers send draw-screen at a fixed rate whether or not anything moved */
+
+typedef struct pushed_frame_s {
+    uint8_t valid;
+    enum display_mode_s display_mode;
+    display_info_t *display_info;
+    uint32_t msp_clear_count; // a clear wipes the FakeHD layout even if the FC redraws the same characters
+    osd_grid_t msp_character_map;
+    osd_grid_t overlay_character_map;
+} pushed_frame_t;
+
+static pushed_frame_t last_pushed_frame;
+static uint32_t skipped_frame_count = 0;
+
+static uint8_t frame_is_unchanged() {
+    return last_pushed_frame.valid
+        && last_pushed_frame.display_mode == render_frame->display_mode
+        && last_pushed_frame.display_info == render_frame->display_info
+        && last_pushed_frame.msp_clear_count == render_frame->msp_clear_count
+        && osd_grid_equal(&last_pushed_frame.msp_character_map, &render_frame->msp_character_map)
+        && osd_grid_equal(&last_pushed_frame.overlay_character_map, &render_frame->overlay_character_map);
 }
 
+static void remember_pushed_frame() {
+    last_pushed_frame.valid = 1;
+    last_pushed_frame.display_mode = render_frame->display_mode;
+    last_pushed_frame.display_info = render_frame->display_info;
+    last_pushed_frame.msp_clear_count = render_frame->msp_clear_count;
+    osd_grid_copy(&last_pushed_frame.msp_character_map, &render_frame->msp_character_map);
+    osd_grid_copy(&last_pushed_frame.overlay_character_map, &render_frame->overlay_character_map);
+}
+
+static void request_render();
+
 static void render_screen() {
+    if (render_frame->display_info == NULL) {
+        // nothing has been published yet
+        return;
+    }
+    if (frame_is_unchanged()) {
+        skipped_frame_count++;
+        DEBUG_PRINT("skipped an unchanged frame (%u so far)\n", skipped_frame_count);
+        return;
+    }
+    int fb = dji_display_acquire_buffer(dji_display);
+    if (fb < 0) {
+        // every buffer is on screen or queued, try again on the next refresh rather than draw over one
+        DEBUG_PRINT("no free framebuffer\n");
+        request_render();
+        return;
+    }
+    which_fb = fb;
+    frame_dirty = 0;
     draw_screen();
-    if (display_mode == DISPLAY_DISABLED) {
+    if (render_frame->display_mode == DISPLAY_DISABLED) {
         clear_framebuffer();
     }
-    dji_display_push_frame(dji_display, which_fb);
-    which_fb = !which_fb;
+    dji_display_push_frame_dirty(dji_display, which_fb, frame_dirty);
+    remember_pushed_frame();
     DEBUG_PRINT("drew a frame\n");
 }
 
-static void msp_draw_complete() {
-    render_screen();
-}
-
-static void msp_callback(msp_msg_t *msp_message)
-{
-    displayport_process_message(display_driver, msp_message);
+/* Render pacing: completing a frame only publishes it, the render thread draws at most once per display refresh */
+
+#define REFRESH_INTERVAL_NS (NSEC_PER_SEC / 60)
+
+static int frame_ready_fd = -1; // signalled by the I/O thread whenever it publishes a frame
+static int vsync_fd = -1; // signalled by the HAL frame cycle callback
+static int render_timer_fd = -1; // stands in for vsync when the callback doesn't fire, e.g. on hosts without the HAL
+static uint8_t render_requested = 0;
+static uint32_t rendered_clear_count = 0;
+
+static void publish_frame() {
+    // I/O thread: fill in our private slot, then swap it for the one waiting to be rendered.
+    osd_frame_t *frame = &frame_slots[publish_slot];
+    frame->display_mode = display_mode;
+    frame->display_info = current_display_info;
+    frame->msp_clear_count = msp_clear_count;
+    osd_grid_copy(&frame->msp_character_map, &msp_character_map);
+    osd_grid_copy(&frame->overlay_character_map, &overlay_character_map);
+    publish_slot = __atomic_exchange_n(&ready_slot, publish_slot | FRAME_SLOT_FRESH, __ATOMIC_ACQ_REL) & ~FRAME_SLOT_FRESH;
+    uint64_t ready = 1;
+    write(frame_ready_fd, &ready, sizeof(ready));
 }
 
-/* Font helper methods */
-
-static void get_font_path_with_prefix(char *font_path_dest, const char *font_path, uint8_t len, uint8_t is_hd, uint8_t page) {
-    char name_buf[len];
-    if (is_hd) {
-        snprintf(name_buf, len, "%s_hd", font_path);
-    } else {
-        snprintf(name_buf, len, "%s", font_path);
+static void pick_up_frame() {
+    // Render thread: take the newest published frame if there is one, otherwise keep rendering the current one.
+    if (!(__atomic_load_n(&ready_slot, __ATOMIC_ACQUIRE) & FRAME_SLOT_FRESH)) {
+        return;
     }
-    if (page > 0) {
-        snprintf(font_path_dest, len, "%s_%d.bin", name_buf, page + 1);
-    } else {
-        snprintf(font_path_dest, len, "%s.bin", name_buf);
-    }
-}
-
-static int open_font(const char *filename, void** font, uint8_t page, uint8_t is_hd) {
-    char file_path[255];
-    get_font_path_with_prefix(file_path, filename, 255, is_hd, page);
-    printf("Opening font: %s\n", file_path);
-    struct stat st;
-    memset(&st, 0, sizeof(st));
-    stat(file_path, &st);
-    size_t filesize = st.st_size;
-    display_info_t display_info = is_hd ? hd_display_info : sd_display_info;
-    size_t desired_filesize = display_info.font_height *  display_info.font_width * NUM_CHARS * BYTES_PER_PIXEL;
-    if(filesize != desired_filesize) {
-        if (filesize != 0) {
-            printf("Font was wrong size: %s %d != %d\n", file_path, filesize, desired_filesize);
-        }
-        return -1;
+    render_slot = __atomic_exchange_n(&ready_slot, render_slot, __ATOMIC_ACQ_REL) & ~FRAME_SLOT_FRESH;
+    render_frame = &frame_slots[render_slot];
+    if (render_frame->msp_clear_count != rendered_clear_count) {
+        osd_grid_clear(&msp_render_character_map);
+        rendered_clear_count = render_frame->msp_clear_count;
     }
-    int fd = open(file_path, O_RDONLY, 0);
-    if (!fd) {
-        printf("Could not open file %s\n", file_path);
-        return -1;
+}
+
+static void request_render() {
+    if (!render_requested) {
+        render_requested = 1;
+        // if no vsync turns up within a refresh, render anyway
+        struct itimerspec timeout = { .it_value = { .tv_sec = 0, .tv_nsec = REFRESH_INTERVAL_NS } };
+        timerfd_settime(render_timer_fd, 0, &timeout, NULL);
     }
-    void* font_data = malloc(desired_filesize);
-    void* mmappedData = mmap(NULL, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (mmappedData != MAP_FAILED) {
-        memcpy(font_data, mmappedData, desired_filesize);
-        *font = font_data;
-    } else {
-        printf("Could not map font %s\n", file_path);
-        free(font_data);
-        *font = 0;
+}
+
+static void render_if_requested() {
+    if (render_requested) {
+        render_requested = 0;
+        struct itimerspec disarm;
+        memset(&disarm, 0, sizeof(disarm));
+        timerfd_settime(render_timer_fd, 0, &disarm, NULL);
+        pick_up_frame();
+        render_screen();
     }
-    close(fd);
-    munmap(mmappedData, desired_filesize);
-    return 0;
 }
 
-static void load_font() {
-    if (open_font(SDCARD_FONT_PATH, &sd_display_info.font_page_1, 0, 0) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &sd_display_info.font_page_1, 0, 0) < 0) {
-          open_font(FALLBACK_FONT_PATH, &sd_display_info.font_page_1, 0, 0);
+static void *render_thread(void *arg) {
+    // Everything that touches the framebuffers happens here, so a slow redraw never holds up the sockets.
+    struct pollfd poll_fds[3];
+    uint64_t event_number;
+    start_band_workers();
+    while (!quit)
+    {
+        poll_fds[0].fd = frame_ready_fd;
+        poll_fds[0].events = POLLIN;
+        // only wake up for refreshes when there is something to render
+        poll_fds[1].fd = vsync_fd;
+        poll_fds[1].events = render_requested ? POLLIN : 0;
+        poll_fds[2].fd = render_timer_fd;
+        poll_fds[2].events = render_requested ? POLLIN : 0;
+        poll(poll_fds, 3, -1);
+
+        if(poll_fds[0].revents) {
+            read(frame_ready_fd, &event_number, sizeof(uint64_t));
+            request_render();
         }
-    }
-    if (open_font(SDCARD_FONT_PATH, &sd_display_info.font_page_2, 1, 0) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &sd_display_info.font_page_2, 1, 0) < 0) {
-          open_font(FALLBACK_FONT_PATH, &sd_display_info.font_page_2, 1, 0);
+        if(poll_fds[1].revents || poll_fds[2].revents) {
+            // Display refreshed, or a refresh went by without the HAL telling us
+            read(vsync_fd, &event_number, sizeof(uint64_t));
+            read(render_timer_fd, &event_number, sizeof(uint64_t));
+            render_if_requested();
         }
     }
-    if (open_font(SDCARD_FONT_PATH, &hd_display_info.font_page_1, 0, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &hd_display_info.font_page_1, 0, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &hd_display_info.font_page_1, 0, 1);
-        }
+    stop_band_workers();
+    return NULL;
+}
+
+static void msp_draw_complete() {
+    // Publish the finished frame, updates for the next one keep going into msp_pending_map.
+    osd_grid_copy(&msp_character_map, &msp_pending_map);
+    if (msp_pending_cleared) {
+        msp_clear_count++;
+        msp_pending_cleared = 0;
     }
-    if (open_font(SDCARD_FONT_PATH, &hd_display_info.font_page_2, 1, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &hd_display_info.font_page_2, 1, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &hd_display_info.font_page_2, 1, 1);
-        }
+    publish_frame();
+}
+
+static void msp_callback(msp_msg_t *msp_message)
+{
+    displayport_process_message(display_driver, msp_message);
+}
+
+/* Batched receive: drain every queued datagram per wakeup */
+
+#define RECV_BATCH_SIZE 8
+#define DATA_PACKET_BUFFER_SIZE 64
+
+typedef struct recv_batch_s {
+    struct mmsghdr msgs[RECV_BATCH_SIZE];
+    struct iovec iovecs[RECV_BATCH_SIZE];
+} recv_batch_t;
+
+static uint8_t msp_recv_buffers[RECV_BATCH_SIZE][MSP_LINK_MAX_DATAGRAM_SIZE];
+static uint8_t data_recv_buffers[RECV_BATCH_SIZE][DATA_PACKET_BUFFER_SIZE];
+static recv_batch_t msp_recv_batch;
+static recv_batch_t data_recv_batch;
+
+static void recv_batch_init(recv_batch_t *batch, uint8_t *buffers, size_t buffer_size) {
+    memset(batch, 0, sizeof(recv_batch_t));
+    for (int i = 0; i < RECV_BATCH_SIZE; i++) {
+        batch->iovecs[i].iov_base = buffers + i * buffer_size;
+        batch->iovecs[i].iov_len = buffer_size;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovecs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
     }
-    if (open_font(SDCARD_FONT_PATH, &full_display_info.font_page_1, 0, 1) < 0)
-    {
-        if (open_font(ENTWARE_FONT_PATH, &full_display_info.font_page_1, 0, 1) < 0)
-        {
-            open_font(FALLBACK_FONT_PATH, &full_display_info.font_page_1, 0, 1);
+}
+
+static int recv_batch(int fd, recv_batch_t *batch) {
+    return recvmmsg(fd, batch->msgs, RECV_BATCH_SIZE, MSG_DONTWAIT, NULL);
+}
+
+static void process_msp_batch(msp_state_t *msp_state, int count) {
+    // Frames completed in the batch only get published, the next vsync renders whichever was newest.
+    for (int i = 0; i < count; i++) {
+        if (0 > msp_link_receive_displayport(&msp_link, msp_state, display_driver, msp_recv_buffers[i], msp_recv_batch.msgs[i].msg_len)) {
+            DEBUG_PRINT("dropped stale MSP packet\n");
         }
     }
-    if (open_font(SDCARD_FONT_PATH, &full_display_info.font_page_2, 1, 1) < 0)
-    {
-        if (open_font(ENTWARE_FONT_PATH, &full_display_info.font_page_2, 1, 1) < 0)
-        {
-            open_font(FALLBACK_FONT_PATH, &full_display_info.font_page_2, 1, 1);
-        }
+}
+
+/* Font helper methods */
+
+static const char *const font_search_paths[] = { SDCARD_FONT_PATH, ENTWARE_FONT_PATH, FALLBACK_FONT_PATH };
+static font_registry_t font_registry;
+
+// one set of spans per distinct font page, SD and HD with two pages each
+#define MAX_FONT_PAGES 4
+static glyph_spans_t glyph_spans[MAX_FONT_PAGES];
+static uint8_t glyph_spans_count = 0;
+
+static const glyph_spans_t *get_glyph_spans(display_info_t *display_info, const void *font) {
+    if (font == NULL) {
+        return NULL;
     }
-    if (open_font(SDCARD_FONT_PATH, &overlay_display_info.font_page_1, 0, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &overlay_display_info.font_page_1, 0, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &overlay_display_info.font_page_1, 0, 1);
+    for (uint8_t i = 0; i < glyph_spans_count; i++) {
+        if (glyph_spans[i].font == font) {
+            return &glyph_spans[i];
         }
     }
-    if (open_font(SDCARD_FONT_PATH, &overlay_display_info.font_page_2, 1, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &overlay_display_info.font_page_2, 1, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &overlay_display_info.font_page_2, 1, 1);
-        }
+    if (glyph_spans_count == MAX_FONT_PAGES
+        || glyph_spans_build(&glyph_spans[glyph_spans_count], font, display_info->font_width, display_info->font_height, font_is_mask ? GLYPH_FORMAT_MASK : GLYPH_FORMAT_DJI) < 0) {
+        // draws whole cells instead
+        return NULL;
     }
+    return &glyph_spans[glyph_spans_count++];
 }
 
+static void load_display_fonts(display_info_t *display_info, uint8_t is_hd) {
+    // Layouts with the same font share the pages the registry already loaded for another layout.
+    size_t size = display_info->font_height * display_info->font_width * NUM_CHARS * BYTES_PER_PIXEL;
+    uint8_t path_count = sizeof(font_search_paths) / sizeof(font_search_paths[0]);
+    display_info->font_page_1 = font_registry_find(&font_registry, font_search_paths, path_count, is_hd, 0, size);
+    display_info->font_page_2 = font_registry_find(&font_registry, font_search_paths, path_count, is_hd, 1, size);
+    display_info->spans_page_1 = get_glyph_spans(display_info, display_info->font_page_1);
+    display_info->spans_page_2 = get_glyph_spans(display_info, display_info->font_page_2);
+}
 
-static void close_fonts(display_info_t *display_info) {
-    if (display_info->font_page_1 != NULL)
-    {
-        free(display_info->font_page_1);
+static void load_font() {
+    if (font_is_mask) {
+        font_registry_init(&font_registry, &blit_rgba_to_mask, 1);
+    } else {
+        font_registry_init(&font_registry, &blit_rgba_to_dji, BYTES_PER_PIXEL);
     }
-    if (display_info->font_page_2 != NULL)
-    {
-        free(display_info->font_page_2);
+    load_display_fonts(&sd_display_info, 0);
+    load_display_fonts(&hd_display_info, 1);
+    load_display_fonts(&full_display_info, 1);
+    load_display_fonts(&overlay_display_info, 1);
+}
+
+static void close_fonts() {
+    sd_display_info.font_page_1 = sd_display_info.font_page_2 = NULL;
+    hd_display_info.font_page_1 = hd_display_info.font_page_2 = NULL;
+    full_display_info.font_page_1 = full_display_info.font_page_2 = NULL;
+    overlay_display_info.font_page_1 = overlay_display_info.font_page_2 = NULL;
+    sd_display_info.spans_page_1 = sd_display_info.spans_page_2 = NULL;
+    hd_display_info.spans_page_1 = hd_display_info.spans_page_2 = NULL;
+    full_display_info.spans_page_1 = full_display_info.spans_page_2 = NULL;
+    overlay_display_info.spans_page_1 = overlay_display_info.spans_page_2 = NULL;
+    for (uint8_t i = 0; i < glyph_spans_count; i++) {
+        glyph_spans_free(&glyph_spans[i]);
     }
+    glyph_spans_count = 0;
+    font_registry_close(&font_registry);
 }
 
 static void msp_set_options(uint8_t font_num, uint8_t is_hd) {
-    msp_clear_screen();
     if(is_hd) {
         current_display_info = &hd_display_info;
     } else {
         current_display_info = &sd_display_info;
     }
+    // the FC starts the new layout from a blank screen of the new size
+    osd_grid_init(&msp_pending_map, current_display_info->char_width, current_display_info->char_height);
+    msp_pending_cleared = 1;
 }
 
 static void display_print_string(uint8_t init_x, uint8_t y, const char *string, uint8_t len) {
-    for(uint8_t x = 0; x < len; x++) {
-        draw_character(&overlay_display_info, overlay_character_map, x + init_x, y, string[x]);
-    }
+    osd_grid_blit_row(&overlay_character_map, init_x, y, (const uint8_t *)string, len, 0);
 }
 
 /* DJI framebuffer configuration */
 
 static duss_result_t pop_func(duss_disp_instance_handle_t *disp_handle,duss_disp_plane_id_t plane_id, duss_frame_buffer_t *frame_buffer,void *user_ctx) {
+    // Called from the HAL's thread once per display refresh, so just track buffer ownership and wake up the main loop.
+    dji_display_frame_popped((dji_display_state_t *)user_ctx, frame_buffer);
+    uint64_t vsync = 1;
+    write(vsync_fd, &vsync, sizeof(vsync));
     return 0;
 }
 
@@ -502,7 +962,7 @@ void dji_display_open_framebuffer_injected(dji_display_state_t *display_state, d
         printf("failed to acquire plane");
         exit(0);
     }
-    res = duss_hal_display_register_frame_cycle_callback(display_state->disp_instance_handle, plane_id, &pop_func, 0);
+    res = duss_hal_display_register_frame_cycle_callback(display_state->disp_instance_handle, plane_id, &pop_func, display_state);
     if (res != 0) {
         printf("failed to register callback");
         exit(0);
@@ -515,61 +975,16 @@ void dji_display_open_framebuffer_injected(dji_display_state_t *display_state, d
         exit(0);
     }
     printf("alloc ion buf\n");
-    res = duss_hal_mem_alloc(display_state->ion_handle,&display_state->ion_buf_0,0x473100,0x400,0,0x17);
-    if (res != 0) {
-        printf("failed to allocate VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_map(display_state->ion_buf_0, &display_state->fb0_virtual_addr);
-    if (res != 0) {
-        printf("failed to map VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_get_phys_addr(display_state->ion_buf_0, &display_state->fb0_physical_addr);
-    if (res != 0) {
-        printf("failed to get FB0 phys addr");
-        exit(0);
-    }
-    printf("first buffer VRAM mapped virtual memory is at %p : %p\n", display_state->fb0_virtual_addr, display_state->fb0_physical_addr);
-
-    res = duss_hal_mem_alloc(display_state->ion_handle,&display_state->ion_buf_1,0x473100,0x400,0,0x17);
-    if (res != 0) {
-        printf("failed to allocate FB1 VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_map(display_state->ion_buf_1,&display_state->fb1_virtual_addr);
-    if (res != 0) {
-        printf("failed to map FB1 VRAM");
-        exit(0);
-    }
-    res = duss_hal_mem_get_phys_addr(display_state->ion_buf_1, &display_state->fb1_physical_addr);
-    if (res != 0) {
-        printf("failed to get FB1 phys addr");
-        exit(0);
-    }
-    printf("second buffer VRAM mapped virtual memory is at %p : %p\n", display_state->fb1_virtual_addr, display_state->fb1_physical_addr);
-
-    for(int i = 0; i < 2; i++) {
-        duss_frame_buffer_t *fb = i ? display_state->fb_1 : display_state->fb_0;
-        fb->buffer = i ? display_state->ion_buf_1 : display_state->ion_buf_0;
-        fb->pixel_format = display_state->is_v2_goggles ? DUSS_PIXFMT_RGBA8888_GOGGLES_V2 : DUSS_PIXFMT_RGBA8888; // 20012 instead on V2
-        fb->frame_id = i;
-        fb->planes[0].bytes_per_line = 0x1680;
-        fb->planes[0].offset = 0;
-        fb->planes[0].plane_height = 810;
-        fb->planes[0].bytes_written = 0x473100;
-        fb->width = 1440;
-        fb->height = 810;
-        fb->plane_count = 1;
-    }
+    dji_display_allocate_buffers(display_state);
 }
 
 /* Display initialization and deinitialization */
 
 static void start_display(uint8_t is_v2_goggles,duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_handle) {
-    memset(msp_character_map, 0, sizeof(msp_character_map));
-    memset(msp_render_character_map, 0, sizeof(msp_render_character_map));
-    memset(overlay_character_map, 0, sizeof(overlay_character_map));
+    osd_grid_init(&msp_character_map, current_display_info->char_width, current_display_info->char_height);
+    osd_grid_init(&msp_pending_map, current_display_info->char_width, current_display_info->char_height);
+    osd_grid_init(&msp_render_character_map, full_display_info.char_width, full_display_info.char_height);
+    osd_grid_init(&overlay_character_map, overlay_display_info.char_width, overlay_display_info.char_height);
 
     dji_display = dji_display_state_alloc(is_v2_goggles);
     dji_display_open_framebuffer_injected(dji_display, disp, ion_handle, PLANE_ID);
@@ -602,6 +1017,17 @@ static void check_is_au_overlay_enabled()
     }
 }
 
+#define SHOW_LINK_STATS_KEY "show_link_stats"
+static int link_stats_enabled = 0;
+
+static void check_is_link_stats_enabled()
+{
+    if (get_boolean_config_value(SHOW_LINK_STATS_KEY))
+    {
+        link_stats_enabled = 1;
+    }
+}
+
 static void process_data_packet(uint8_t *buf, int len, dji_shm_state_t *radio_shm) {
     packet_data_t *packet = (packet_data_t *)buf;
     DEBUG_PRINT("got data %f mbit %d C %f V\n", packet->tx_bitrate / 1000.0f, packet->tx_temperature, packet->tx_voltage / 64.0f);
@@ -613,6 +1039,13 @@ static void process_data_packet(uint8_t *buf, int len, dji_shm_state_t *radio_sh
         snprintf(str, 8, "A %2.1fV", packet->tx_voltage / 64.0f);
         display_print_string(overlay_display_info.char_width - 7, overlay_display_info.char_height - 7, str, 7);
     }
+    if(link_stats_enabled) {
+        // frames the radio lost, and frames dropped for arriving after a newer one
+        snprintf(str, 8, "L %5u", msp_link.stats.lost > 99999 ? 99999 : msp_link.stats.lost);
+        display_print_string(overlay_display_info.char_width - 7, overlay_display_info.char_height - 6, str, 7);
+        snprintf(str, 8, "R %5u", msp_link.stats.reordered > 99999 ? 99999 : msp_link.stats.reordered);
+        display_print_string(overlay_display_info.char_width - 7, overlay_display_info.char_height - 5, str, 7);
+    }
 }
 
 /* Public OSD enable/disable methods */
@@ -627,12 +1060,18 @@ void osd_enable() {
     write(event_fd, &enable, sizeof(uint64_t));
 }
 
+uint32_t osd_skipped_frame_count() {
+    return skipped_frame_count;
+}
+
 /* Entry point and main loop */
 
 void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_handle)
 {
     check_is_fakehd_enabled();
     check_is_au_overlay_enabled();
+    check_is_link_stats_enabled();
+    check_font_colors();
 
     uint8_t is_v2_goggles = dji_goggles_are_v2();
     printf("Detected DJI goggles %s\n", is_v2_goggles ? "V2" : "V1");
@@ -645,6 +1084,7 @@ void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_h
 
     display_driver = calloc(1, sizeof(displayport_vtable_t));
     display_driver->draw_character = &msp_draw_character;
+    display_driver->draw_string = &msp_draw_string;
     display_driver->clear_screen = &msp_clear_screen;
     display_driver->draw_complete = &msp_draw_complete;
     display_driver->set_options = &msp_set_options;
@@ -655,6 +1095,14 @@ void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_h
     event_fd = eventfd(0, NULL);
     assert(event_fd > 0);
 
+    frame_ready_fd = eventfd(0, EFD_NONBLOCK);
+    assert(frame_ready_fd > 0);
+
+    vsync_fd = eventfd(0, EFD_NONBLOCK);
+    assert(vsync_fd > 0);
+    render_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    assert(render_timer_fd > 0);
+
     dji_shm_state_t radio_shm;
     memset(&radio_shm, 0, sizeof(radio_shm));
 
@@ -666,9 +1114,8 @@ void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_h
     struct pollfd poll_fds[3];
     int recv_len = 0;
     uint8_t byte = 0;
-    uint8_t buffer[4096];
-    struct sockaddr_storage src_addr;
-    socklen_t src_addr_len=sizeof(src_addr);
+    recv_batch_init(&msp_recv_batch, &msp_recv_buffers[0][0], sizeof(msp_recv_buffers[0]));
+    recv_batch_init(&data_recv_batch, &data_recv_buffers[0][0], sizeof(data_recv_buffers[0]));
     struct input_event ev;
     struct timespec button_start, display_start, now;
     memset(&display_start, 0, sizeof(display_start));
@@ -678,6 +1125,12 @@ void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_h
     open_dji_radio_shm(&radio_shm);
     start_display(is_v2_goggles, disp, ion_handle);
 
+    pthread_t render_thread_id;
+    if (0 != pthread_create(&render_thread_id, NULL, &render_thread, NULL)) {
+        printf("failed to start render thread\n");
+        exit(0);
+    }
+
     uint64_t event_number;
 
     while (!quit)
@@ -691,23 +1144,22 @@ void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_h
         poll(poll_fds, 3, -1);
 
         if(poll_fds[0].revents) {
-            // Got MSP UDP packet
-            if (0 < (recv_len = recvfrom(msp_socket_fd,&buffer,sizeof(buffer),0,(struct sockaddr*)&src_addr,&src_addr_len)))
+            // Got MSP UDP packets
+            if (0 < (recv_len = recv_batch(msp_socket_fd, &msp_recv_batch)))
             {
-                DEBUG_PRINT("got MSP packet len %d\n", recv_len);
+                DEBUG_PRINT("got %d MSP packets\n", recv_len);
                 if(display_mode == DISPLAY_RUNNING) {
-                    for (int i=0; i<recv_len; i++)
-                        msp_process_data(msp_state, buffer[i]);
+                    process_msp_batch(msp_state, recv_len);
                 }
             }
         }
         if(poll_fds[2].revents) {
-            // Got data UDP packet
-            if (0 < (recv_len = recvfrom(data_socket_fd,&buffer,sizeof(buffer),0,(struct sockaddr*)&src_addr,&src_addr_len)))
+            // Got data UDP packets, only the newest one matters
+            if (0 < (recv_len = recv_batch(data_socket_fd, &data_recv_batch)))
             {
-                DEBUG_PRINT("got DATA packet len %d\n", recv_len);
+                DEBUG_PRINT("got %d DATA packets\n", recv_len);
                 if(display_mode == DISPLAY_RUNNING) {
-                    process_data_packet(buffer, recv_len, &radio_shm);
+                    process_data_packet(data_recv_buffers[recv_len - 1], data_recv_batch.msgs[recv_len - 1].msg_len, &radio_shm);
                 }
             }
         }
@@ -719,15 +1171,23 @@ void osd_directfb(duss_disp_instance_handle_t *disp, duss_hal_obj_handle_t ion_h
                 } else {
                     display_mode = DISPLAY_DISABLED;
                 }
-                render_screen();
+                publish_frame();
             }
         }
     }
 
+    // wake the render thread so it sees quit
+    uint64_t wake = 1;
+    write(frame_ready_fd, &wake, sizeof(wake));
+    pthread_join(render_thread_id, NULL);
+
     free(display_driver);
     free(msp_state);
     close(msp_socket_fd);
     close(data_socket_fd);
     close(event_fd);
+    close(frame_ready_fd);
+    close(vsync_fd);
+    close(render_timer_fd);
     return;
 }
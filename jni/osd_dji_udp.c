@@ -18,11 +18,15 @@
 #include "hw/dji_display.h"
 #include "hw/dji_radio_shm.h"
 #include "hw/dji_services.h"
+#include "net/msp_link.h"
 #include "net/network.h"
 #include "net/data_protocol.h"
 #include "msp/msp.h"
 #include "msp/msp_displayport.h"
+#include "net/msp_link_displayport.h"
+#include "font/font_registry.h"
 #include "util/fs_util.h"
+#include "util/osd_grid.h"
 
 #define MSP_PORT 7654
 #define DATA_PORT 7655
@@ -58,9 +62,6 @@
 ( (((data) >> 24) & 0x000000FF) | (((data) >>  8) & 0x0000FF00) | \
   (((data) <<  8) & 0x00FF0000) | (((data) << 24) & 0xFF000000) )
 
-#define MAX_DISPLAY_X 50
-#define MAX_DISPLAY_Y 18
-
 typedef struct display_info_s {
     uint8_t char_width;
     uint8_t char_height;
@@ -68,15 +69,16 @@ typedef struct display_info_s {
     uint8_t font_height;
     uint16_t x_offset;
     uint16_t y_offset;
-    void *font_page_1;
-    void *font_page_2;
+    const void *font_page_1;
+    const void *font_page_2;
 } display_info_t; 
 
 static volatile sig_atomic_t quit = 0;
 static dji_display_state_t *dji_display;
-static uint16_t msp_character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y];
-static uint16_t overlay_character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y];
+static osd_grid_t msp_character_map;
+static osd_grid_t overlay_character_map;
 static displayport_vtable_t *display_driver;
+static msp_link_rx_t msp_link;
 static uint8_t which_fb = 0;
 
 static display_info_t sd_display_info = {
@@ -119,27 +121,24 @@ static void sig_handler(int _)
     quit = 1;
 }
 
-static void draw_character(display_info_t *display_info, uint16_t character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y], uint32_t x, uint32_t y, uint16_t c)
-{
-    if ((x > (display_info->char_width - 1)) || (y > (display_info->char_height - 1))) {
-        return;
-    }
-    character_map[x][y] = c;
+static void msp_draw_character(uint32_t x, uint32_t y, uint16_t c) {
+    osd_grid_set(&msp_character_map, x, y, c);
 }
 
-static void msp_draw_character(uint32_t x, uint32_t y, uint16_t c) {
-    draw_character(current_display_info, msp_character_map, x, y, c);
+static void msp_draw_string(uint32_t x, uint32_t y, uint8_t *string, uint16_t len, uint8_t page) {
+    osd_grid_blit_row(&msp_character_map, x, y, string, len, page);
 }
 
-static void draw_character_map(display_info_t *display_info, void *fb_addr, uint16_t character_map[MAX_DISPLAY_X][MAX_DISPLAY_Y]) {
+static void draw_character_map(display_info_t *display_info, void *fb_addr, const osd_grid_t *character_map) {
     if (display_info->font_page_1 == NULL) {
         // give up if we don't have a font loaded
         return;
     }
-    void *font;
+    const void *font;
     for(int y = 0; y < display_info->char_height; y++) {
+        const uint16_t *row = OSD_GRID_ROW(character_map, y);
         for(int x = 0; x < display_info->char_width; x++) {
-            uint16_t c = character_map[x][y];
+            uint16_t c = row[x];
             if (c != 0) {
                 font = display_info->font_page_1;
                 if (c > 255) {
@@ -175,19 +174,25 @@ static void draw_screen() {
     // DJI has a backwards alpha channel - FF is transparent, 00 is opaque.
     memset(fb_addr, 0x000000FF, WIDTH * HEIGHT * BYTES_PER_PIXEL);
     
-    draw_character_map(current_display_info, fb_addr, msp_character_map);
-    draw_character_map(&overlay_display_info, fb_addr, overlay_character_map);
+    draw_character_map(current_display_info, fb_addr, &msp_character_map);
+    draw_character_map(&overlay_display_info, fb_addr, &overlay_character_map);
 }
 
 static void msp_clear_screen()
 {
-    memset(msp_character_map, 0, sizeof(msp_character_map));
+    osd_grid_clear(&msp_character_map);
 }
 
 static void msp_draw_complete() {
+    int fb = dji_display_acquire_buffer(dji_display);
+    if (fb < 0) {
+        // every buffer is still on screen or queued, drop this frame rather than draw over one
+        DEBUG_PRINT("no free framebuffer\n");
+        return;
+    }
+    which_fb = fb;
     draw_screen();
     dji_display_push_frame(dji_display, which_fb);
-    which_fb = !which_fb;
     DEBUG_PRINT("drew a frame\n");
 }
 
@@ -196,115 +201,50 @@ static void msp_callback(msp_msg_t *msp_message)
     displayport_process_message(display_driver, msp_message);
 }
 
-static void get_font_path_with_prefix(char *font_path_dest, const char *font_path, uint8_t len, uint8_t is_hd, uint8_t page) {
-    char name_buf[len];
-    if (is_hd) {
-        snprintf(name_buf, len, "%s_hd", font_path);
-    } else {
-        snprintf(name_buf, len, "%s", font_path);
-    }
-    if (page > 0) {
-        snprintf(font_path_dest, len, "%s_%d.bin", name_buf, page + 1);
-    } else {
-        snprintf(font_path_dest, len, "%s.bin", name_buf);
-    }
-}
+/* Font helper methods */
 
-static int open_font(const char *filename, void** font, uint8_t page, uint8_t is_hd) {
-    char file_path[255];
-    get_font_path_with_prefix(file_path, filename, 255, is_hd, page);
-    printf("Opening font: %s\n", file_path);
-    struct stat st;
-    memset(&st, 0, sizeof(st));
-    stat(file_path, &st);
-    size_t filesize = st.st_size;
-    display_info_t display_info = is_hd ? hd_display_info : sd_display_info;
-    size_t desired_filesize = display_info.font_height *  display_info.font_width * NUM_CHARS * BYTES_PER_PIXEL;
-    if(filesize != desired_filesize) {
-        if (filesize != 0) {
-            printf("Font was wrong size: %s %d != %d\n", file_path, filesize, desired_filesize);
-        }
-        return -1;
-    }
-    int fd = open(file_path, O_RDONLY, 0);
-    if (!fd) {
-        printf("Could not open file %s\n", file_path);
-        return -1;
-    }
-    void* mmappedData = mmap(NULL, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
-    // there is no need to keep an FD open after mmap
-    close(fd);
-    if (mmappedData != MAP_FAILED) {
-        *font = mmappedData;
-    } else {
-        printf("Could not map font %s\n", file_path);
-        *font = 0;
-    }
-    return 0;
+static const char *const font_search_paths[] = { SDCARD_FONT_PATH, ENTWARE_FONT_PATH, FALLBACK_FONT_PATH };
+static font_registry_t font_registry;
+
+static void load_display_fonts(display_info_t *display_info, uint8_t is_hd) {
+    // Layouts with the same font share the pages the registry already loaded for another layout.
+    size_t size = display_info->font_height * display_info->font_width * NUM_CHARS * BYTES_PER_PIXEL;
+    uint8_t path_count = sizeof(font_search_paths) / sizeof(font_search_paths[0]);
+    display_info->font_page_1 = font_registry_find(&font_registry, font_search_paths, path_count, is_hd, 0, size);
+    display_info->font_page_2 = font_registry_find(&font_registry, font_search_paths, path_count, is_hd, 1, size);
 }
 
 static void load_font() {
-    if (open_font(SDCARD_FONT_PATH, &sd_display_info.font_page_1, 0, 0) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &sd_display_info.font_page_1, 0, 0) < 0) {
-          open_font(FALLBACK_FONT_PATH, &sd_display_info.font_page_1, 0, 0);
-        }
-    }
-    if (open_font(SDCARD_FONT_PATH, &sd_display_info.font_page_2, 1, 0) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &sd_display_info.font_page_2, 1, 0) < 0) {
-          open_font(FALLBACK_FONT_PATH, &sd_display_info.font_page_2, 1, 0);
-        }
-    }
-    if (open_font(SDCARD_FONT_PATH, &hd_display_info.font_page_1, 0, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &hd_display_info.font_page_1, 0, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &hd_display_info.font_page_1, 0, 1);
-        }
-    }
-    if (open_font(SDCARD_FONT_PATH, &hd_display_info.font_page_2, 1, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &hd_display_info.font_page_2, 1, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &hd_display_info.font_page_2, 1, 1);
-        }
-    }
-    if (open_font(SDCARD_FONT_PATH, &overlay_display_info.font_page_1, 0, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &overlay_display_info.font_page_1, 0, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &overlay_display_info.font_page_1, 0, 1);
-        }
-    }
-    if (open_font(SDCARD_FONT_PATH, &overlay_display_info.font_page_2, 1, 1) < 0) {
-        if (open_font(ENTWARE_FONT_PATH, &overlay_display_info.font_page_2, 1, 1) < 0) {
-          open_font(FALLBACK_FONT_PATH, &overlay_display_info.font_page_2, 1, 1);
-        }
-    }
+    font_registry_init(&font_registry, NULL, BYTES_PER_PIXEL);
+    load_display_fonts(&sd_display_info, 0);
+    load_display_fonts(&hd_display_info, 1);
+    load_display_fonts(&overlay_display_info, 1);
 }
 
-static void close_fonts(display_info_t *display_info) {
-    if (display_info->font_page_1 != NULL)
-    {
-        munmap(display_info->font_page_1, display_info->font_height * display_info->font_width * NUM_CHARS * 4);
-    }
-    if (display_info->font_page_2 != NULL)
-    {
-        munmap(display_info->font_page_2, display_info->font_height * display_info->font_width * NUM_CHARS * 4);
-    }
+static void close_fonts() {
+    sd_display_info.font_page_1 = sd_display_info.font_page_2 = NULL;
+    hd_display_info.font_page_1 = hd_display_info.font_page_2 = NULL;
+    overlay_display_info.font_page_1 = overlay_display_info.font_page_2 = NULL;
+    font_registry_close(&font_registry);
 }
 
 static void msp_set_options(uint8_t font_num, uint8_t is_hd) {
-    msp_clear_screen();
     if(is_hd) { 
         current_display_info = &hd_display_info;
     } else {
         current_display_info = &sd_display_info;
     }
+    // the FC starts the new layout from a blank screen of the new size
+    osd_grid_init(&msp_character_map, current_display_info->char_width, current_display_info->char_height);
 }
 
 static void display_print_string(uint8_t init_x, uint8_t y, const char *string, uint8_t len) {
-    for(uint8_t x = 0; x < len; x++) {
-        draw_character(&overlay_display_info, overlay_character_map, x + init_x, y, string[x]);
-    }
+    osd_grid_blit_row(&overlay_character_map, init_x, y, (const uint8_t *)string, len, 0);
 }
 
 static void start_display(uint8_t is_v2_goggles) {
-    memset(msp_character_map, 0, sizeof(msp_character_map));
-    memset(overlay_character_map, 0, sizeof(overlay_character_map));
+    osd_grid_init(&msp_character_map, current_display_info->char_width, current_display_info->char_height);
+    osd_grid_init(&overlay_character_map, overlay_display_info.char_width, overlay_display_info.char_height);
 
     dji_display = dji_display_state_alloc(is_v2_goggles);
     dji_display_open_framebuffer(dji_display, PLANE_ID);
@@ -321,7 +261,7 @@ static void stop_display() {
 static void process_data_packet(uint8_t *buf, int len, dji_shm_state_t *radio_shm) {
     packet_data_t *packet = (packet_data_t *)buf;
     DEBUG_PRINT("got data %f mbit %d C %f V\n", packet->tx_bitrate / 1000.0f, packet->tx_temperature, packet->tx_voltage / 64.0f);
-    memset(overlay_character_map, 0, sizeof(overlay_character_map));
+    osd_grid_clear(&overlay_character_map);
     char str[8];
     snprintf(str, 8, "%2.1fMB ", packet->tx_bitrate / 1000.0f);
     display_print_string(overlay_display_info.char_width - 6, overlay_display_info.char_height - 5, str, 6);
@@ -348,6 +288,7 @@ int main(int argc, char *argv[])
 
     display_driver = calloc(1, sizeof(displayport_vtable_t));
     display_driver->draw_character = &msp_draw_character;
+    display_driver->draw_string = &msp_draw_string;
     display_driver->clear_screen = &msp_clear_screen;
     display_driver->draw_complete = &msp_draw_complete;
     display_driver->set_options = &msp_set_options;
@@ -369,7 +310,7 @@ int main(int argc, char *argv[])
     struct pollfd poll_fds[3];
     int recv_len = 0;
     uint8_t byte = 0;
-    uint8_t buffer[4096];
+    uint8_t buffer[MSP_LINK_MAX_DATAGRAM_SIZE];
     struct sockaddr_storage src_addr;
     socklen_t src_addr_len=sizeof(src_addr);
     struct input_event ev;
@@ -408,9 +349,7 @@ int main(int argc, char *argv[])
                     stop_display();
                     close_dji_radio_shm(&radio_shm);
                 }
-                close_fonts(&sd_display_info);
-                close_fonts(&hd_display_info);
-                close_fonts(&overlay_display_info);
+                close_fonts();
                 display_mode = DISPLAY_DISABLED;
                 dji_start_goggles(is_v2_goggles);
             }
@@ -441,8 +380,9 @@ int main(int argc, char *argv[])
             {
                 DEBUG_PRINT("got MSP packet len %d\n", recv_len);
                 if(display_mode == DISPLAY_RUNNING) {
-                    for (int i=0; i<recv_len; i++)
-                        msp_process_data(msp_state, buffer[i]);
+                    if (0 > msp_link_receive_displayport(&msp_link, msp_state, display_driver, buffer, recv_len)) {
+                        DEBUG_PRINT("dropped stale MSP packet\n");
+                    }
                 }
             }
         }
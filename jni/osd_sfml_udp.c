@@ -14,8 +14,11 @@
 
 #include "msp/msp.h"
 #include "msp/msp_displayport.h"
+#include "net/msp_link_displayport.h"
 #include "net/serial.h"
+#include "net/msp_link.h"
 #include "net/network.h"
+#include "util/osd_grid.h"
 
 #ifdef DEBUG
 #define DEBUG_PRINT(fmt, args...)    fprintf(stderr, fmt, ## args)
@@ -50,9 +53,6 @@ static const display_info_t hd_display_info = {
     .num_chars = 512,
 };
 
-#define MAX_OSD_WIDTH 50
-#define MAX_OSD_HEIGHT 18
-
 static display_info_t current_display_info = SD_DISPLAY_INFO;
 
 static volatile sig_atomic_t quit = 0;
@@ -61,8 +61,9 @@ sfTexture *font_2;
 sfSprite *font_sprite_1;
 sfSprite *font_sprite_2;
 sfRenderWindow *window;
-uint16_t character_map[MAX_OSD_WIDTH][MAX_OSD_HEIGHT];
+osd_grid_t character_map;
 displayport_vtable_t *display_driver;
+msp_link_rx_t msp_link;
 
 static void sig_handler(int _)
 {
@@ -71,11 +72,12 @@ static void sig_handler(int _)
 
 static void draw_character(uint32_t x, uint32_t y, uint16_t c)
 {
-    if (x > current_display_info.char_width - 1 || y > current_display_info.char_height - 1)
-    {
-        return;
-    }
-    character_map[x][y] = c;
+    osd_grid_set(&character_map, x, y, c);
+}
+
+static void draw_string(uint32_t x, uint32_t y, uint8_t *string, uint16_t len, uint8_t page)
+{
+    osd_grid_blit_row(&character_map, x, y, string, len, page);
 }
 
 static void draw_screen()
@@ -83,9 +85,10 @@ static void draw_screen()
     sfRenderWindow_clear(window, sfColor_fromRGB(55, 55, 55));
     for (int y = 0; y < current_display_info.char_height; y++)
     {
+        const uint16_t *row = OSD_GRID_ROW(&character_map, y);
         for (int x = 0; x < current_display_info.char_width; x++)
         {
-            uint16_t c = character_map[x][y];
+            uint16_t c = row[x];
             if (c != 0)
             {
                 uint8_t page = 0;
@@ -110,7 +113,7 @@ static void draw_screen()
 static void clear_screen()
 {
     DEBUG_PRINT("clear\n");
-    memset(character_map, 0, sizeof(character_map));
+    osd_grid_clear(&character_map);
 }
 
 static void draw_complete()
@@ -131,13 +134,14 @@ static void set_options(uint8_t font, uint8_t is_hd) {
     } else {
         current_display_info = sd_display_info;
     }
+    osd_grid_init(&character_map, current_display_info.char_width, current_display_info.char_height);
 }
 
 int main(int argc, char *argv[])
 {
     struct pollfd poll_fds[1];
     signal(SIGINT, sig_handler);
-    memset(character_map, 0, sizeof(character_map));
+    osd_grid_init(&character_map, current_display_info.char_width, current_display_info.char_height);
     sfVideoMode videoMode = {1440, 810, 32};
     window = sfRenderWindow_create(videoMode, "MSP OSD", 0, NULL);
     sfRenderWindow_display(window);
@@ -159,6 +163,7 @@ int main(int argc, char *argv[])
 
     display_driver = calloc(1, sizeof(displayport_vtable_t));
     display_driver->draw_character = &draw_character;
+    display_driver->draw_string = &draw_string;
     display_driver->clear_screen = &clear_screen;
     display_driver->draw_complete = &draw_complete;
     display_driver->set_options = &set_options;
@@ -168,7 +173,7 @@ int main(int argc, char *argv[])
 
     int socket_fd = bind_socket(PORT);
     int recv_len = 0;
-    uint8_t buffer[4096];
+    uint8_t buffer[MSP_LINK_MAX_DATAGRAM_SIZE];
 
     struct timespec fps_start, now;
     uint32_t message_counter = 0;
@@ -204,8 +209,9 @@ int main(int argc, char *argv[])
             if (0 < (recv_len = recvfrom(socket_fd,&buffer,sizeof(buffer),0,(struct sockaddr*)&src_addr,&src_addr_len)))
             {
                 message_counter++;
-                for (int i=0; i<recv_len; i++) 
-                    msp_process_data(msp_state, buffer[i]);
+                if (0 > msp_link_receive_displayport(&msp_link, msp_state, display_driver, buffer, recv_len)) {
+                    DEBUG_PRINT("dropped stale MSP packet\n");
+                }
             }
         }
     }
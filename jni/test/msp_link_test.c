@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../net/msp_link.h"
+
+// Host test of the MSP UDP link: datagrams go through a local socket pair so the receiver
+// sees exactly what the air unit would put on the wire, and the test decides which ones get lost.
+
+static int fds[2];
+static uint8_t datagram[MSP_LINK_MAX_DATAGRAM_SIZE];
+static int failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            printf("FAIL %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+            return; \
+        } \
+    } while (0)
+
+static int next_datagram() {
+    return recv(fds[1], datagram, sizeof(datagram), MSG_DONTWAIT);
+}
+
+static void fill_payload(uint8_t *payload, uint16_t len, uint16_t n) {
+    for (uint16_t i = 0; i < len; i++) {
+        payload[i] = (uint8_t)(n * 31 + i);
+    }
+}
+
+static void test_sender_restart() {
+    // A restarted air unit starts over at seq 0 with a CLOCK_MONOTONIC that is behind the one it had before.
+    msp_link_tx_t tx;
+    msp_link_rx_t rx;
+    memset(&rx, 0, sizeof(rx));
+    uint8_t payload[64];
+    uint8_t *received;
+    for (int boot = 0; boot < 2; boot++) {
+        msp_link_tx_init(&tx, 0, 0);
+        tx.session = boot + 1;
+        for (uint16_t n = 0; n < 100; n++) {
+            fill_payload(payload, sizeof(payload), n);
+            msp_link_send(&tx, fds[0], 0, payload, sizeof(payload));
+            int len = next_datagram();
+            CHECK(len == (int)(sizeof(msp_link_header_t) + sizeof(payload)), "boot %d datagram %u is %d bytes", boot, n, len);
+            if (boot == 1) {
+                ((msp_link_header_t *)datagram)->timestamp_ms -= 600000;
+            }
+            len = msp_link_receive(&rx, datagram, len, &received);
+            CHECK(len == sizeof(payload) && memcmp(received, payload, len) == 0, "boot %d datagram %u was not delivered", boot, n);
+        }
+    }
+    CHECK(rx.stats.received == 200 && rx.stats.reordered == 0 && rx.stats.lost == 0,
+        "received %u reordered %u lost %u", rx.stats.received, rx.stats.reordered, rx.stats.lost);
+}
+
+static void test_parity_recovery() {
+    // Lose each position of a parity group in turn. Only the newest datagram of the group may come back out of
+    // the parity datagram, the older ones are rebuilt after newer ones were delivered and must not be.
+    static msp_link_tx_t tx;
+    static msp_link_rx_t rx;
+    memset(&rx, 0, sizeof(rx));
+    msp_link_tx_init(&tx, 4, 0);
+    uint8_t payloads[4][200];
+    uint16_t lens[4] = { 200, 37, 150, 90 };
+    uint8_t *received;
+    for (int lost = -1; lost < 4; lost++) {
+        // the receiver learns the group size from the first parity datagram, so the first group loses nothing
+        for (uint16_t n = 0; n < 4; n++) {
+            fill_payload(payloads[n], lens[n], n + lost * 4);
+            msp_link_send(&tx, fds[0], 0, payloads[n], lens[n]);
+            int len = next_datagram();
+            if (n == lost) {
+                continue;
+            }
+            len = msp_link_receive(&rx, datagram, len, &received);
+            CHECK(len == lens[n] && memcmp(received, payloads[n], len) == 0, "lost %d datagram %u was not delivered", lost, n);
+        }
+        int len = next_datagram();
+        CHECK(len > 0 && (((msp_link_header_t *)datagram)->flags & MSP_LINK_FLAG_PARITY), "lost %d no parity datagram", lost);
+        uint32_t recovered = rx.stats.recovered;
+        len = msp_link_receive(&rx, datagram, len, &received);
+        if (lost < 0) {
+            CHECK(len < 0, "lost %d parity datagram delivered %d bytes", lost, len);
+        } else if (lost < 3) {
+            CHECK(len < 0, "lost %d was delivered after newer datagrams", lost);
+            CHECK(rx.stats.recovered == recovered + 1, "lost %d was not counted as recovered", lost);
+        } else {
+            CHECK(len == lens[lost] && memcmp(received, payloads[lost], len) == 0, "lost %d was not recovered", lost);
+            CHECK(rx.stats.recovered == recovered + 1, "lost %d was not counted as recovered", lost);
+        }
+    }
+    CHECK(rx.stats.received == 17 && rx.stats.recovered == 4 && rx.stats.lost == 3 && rx.stats.reordered == 0,
+        "received %u recovered %u lost %u reordered %u", rx.stats.received, rx.stats.recovered, rx.stats.lost, rx.stats.reordered);
+}
+
+static void test_compress_short() {
+    // Payloads too short to shrink go out as they are.
+    static msp_link_tx_t tx;
+    static msp_link_rx_t rx;
+    memset(&rx, 0, sizeof(rx));
+    msp_link_tx_init(&tx, 0, 1);
+    uint8_t payload[1] = { 0x42 };
+    uint8_t *received;
+    for (uint16_t len = 0; len <= sizeof(payload); len++) {
+        msp_link_send(&tx, fds[0], 0, payload, len);
+        int received_len = msp_link_receive(&rx, datagram, next_datagram(), &received);
+        CHECK(received_len == len && memcmp(received, payload, len) == 0, "%u byte payload came back as %d bytes", len, received_len);
+        CHECK(!(rx.payload_flags & MSP_LINK_FLAG_COMPRESSED), "%u byte payload was sent compressed", len);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0) {
+        printf("Failed to create socket pair\n");
+        return 1;
+    }
+    test_sender_restart();
+    test_parity_recovery();
+    test_compress_short();
+    close(fds[0]);
+    close(fds[1]);
+    if (failures) {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+    printf("All passed\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdint.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
+#include "blit.h"
+
+// Copy a run of RGBA font pixels into the DJI plane format.
+// DJI wants BGRA with a backwards alpha channel - FF is transparent, 00 is opaque.
+
+void blit_rgba_to_dji(uint8_t *restrict dst, const uint8_t *restrict src, uint32_t pixels) {
+#ifdef HAVE_NEON
+    // vld4 de-interleaves the channels, so swapping R/B is just swapping registers.
+    while (pixels >= 16) {
+        uint8x16x4_t px = vld4q_u8(src);
+        uint8x16_t r = px.val[0];
+        px.val[0] = px.val[2];
+        px.val[2] = r;
+        px.val[3] = vmvnq_u8(px.val[3]);
+        vst4q_u8(dst, px);
+        src += 16 * 4;
+        dst += 16 * 4;
+        pixels -= 16;
+    }
+    if (pixels >= 8) {
+        uint8x8x4_t px = vld4_u8(src);
+        uint8x8_t r = px.val[0];
+        px.val[0] = px.val[2];
+        px.val[2] = r;
+        px.val[3] = vmvn_u8(px.val[3]);
+        vst4_u8(dst, px);
+        src += 8 * 4;
+        dst += 8 * 4;
+        pixels -= 8;
+    }
+#endif
+    while (pixels > 0) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = ~src[3];
+        src += 4;
+        dst += 4;
+        pixels--;
+    }
+}
+
+// Alpha mask fonts: one byte per pixel, coverage in the high nibble and a shade between the outline colour (0)
+// and the text colour (0xF) in the low nibble, so colours can be picked at render time rather than baked in.
+
+void blit_rgba_to_mask(uint8_t *restrict dst, const uint8_t *restrict src, uint32_t pixels) {
+    while (pixels > 0) {
+        uint32_t coverage = (src[3] * 15 + 127) / 255;
+        uint32_t luminance = (src[0] * 77 + src[1] * 150 + src[2] * 29) >> 8;
+        uint32_t shade = (luminance * 15 + 127) / 255;
+        *dst = (coverage << 4) | shade;
+        src += 4;
+        dst++;
+        pixels--;
+    }
+}
+
+void blit_build_mask_palette(uint32_t *palette, uint32_t text_rgb, uint32_t outline_rgb) {
+    // Every mask byte as an RGBA pixel, then converted in one go so mask pixels expand with a single lookup.
+    uint8_t rgba[256 * 4];
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t coverage = i >> 4;
+        uint32_t shade = i & 0xF;
+        for (uint8_t channel = 0; channel < 3; channel++) {
+            uint32_t shift = 16 - channel * 8;
+            uint32_t text = (text_rgb >> shift) & 0xFF;
+            uint32_t outline = (outline_rgb >> shift) & 0xFF;
+            rgba[i * 4 + channel] = (outline * (15 - shade) + text * shade + 7) / 15;
+        }
+        rgba[i * 4 + 3] = coverage * 17;
+    }
+    blit_rgba_to_dji((uint8_t *)palette, rgba, 256);
+}
+
+void blit_mask_to_dji(uint8_t *restrict dst, const uint8_t *restrict src, uint32_t pixels, const uint32_t *restrict palette) {
+    uint32_t *out = (uint32_t *)dst;
+    for (uint32_t i = 0; i < pixels; i++) {
+        out[i] = palette[src[i]];
+    }
+}
@@ -0,0 +1,6 @@
+#include <stdint.h>
+
+void blit_rgba_to_dji(uint8_t *dst, const uint8_t *src, uint32_t pixels);
+void blit_rgba_to_mask(uint8_t *dst, const uint8_t *src, uint32_t pixels);
+void blit_build_mask_palette(uint32_t *palette, uint32_t text_rgb, uint32_t outline_rgb);
+void blit_mask_to_dji(uint8_t *dst, const uint8_t *src, uint32_t pixels, const uint32_t *palette);
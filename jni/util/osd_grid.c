@@ -0,0 +1,79 @@
+#include <string.h>
+
+#include "osd_grid.h"
+
+void osd_grid_init(osd_grid_t *grid, uint8_t width, uint8_t height) {
+    // Resize and blank the whole grid, including any cells the old size used.
+    if (width > OSD_GRID_MAX_WIDTH) {
+        width = OSD_GRID_MAX_WIDTH;
+    }
+    if (height > OSD_GRID_MAX_HEIGHT) {
+        height = OSD_GRID_MAX_HEIGHT;
+    }
+    memset(grid->cells, 0, sizeof(grid->cells));
+    grid->width = width;
+    grid->height = height;
+}
+
+void osd_grid_clear(osd_grid_t *grid) {
+    memset(grid->cells, 0, grid->height * OSD_GRID_STRIDE * sizeof(uint16_t));
+}
+
+void osd_grid_copy(osd_grid_t *dst, const osd_grid_t *src) {
+    if (dst->width == src->width && dst->height == src->height) {
+        memcpy(dst->cells, src->cells, src->height * OSD_GRID_STRIDE * sizeof(uint16_t));
+    } else {
+        // the rows the smaller grid doesn't cover have to come across as zeroes too
+        memcpy(dst, src, sizeof(osd_grid_t));
+    }
+}
+
+uint8_t osd_grid_equal(const osd_grid_t *a, const osd_grid_t *b) {
+    return a->width == b->width && a->height == b->height
+        && memcmp(a->cells, b->cells, a->height * OSD_GRID_STRIDE * sizeof(uint16_t)) == 0;
+}
+
+uint32_t osd_grid_diff(const osd_grid_t *a, const osd_grid_t *b, uint8_t *dirty) {
+    // Set dirty (laid out like the grids) to 1 for each cell that differs, and return how many do.
+    // Cells outside either grid read as 0, so this covers the larger of the two sizes.
+    uint8_t width = a->width > b->width ? a->width : b->width;
+    uint8_t height = a->height > b->height ? a->height : b->height;
+    uint32_t changed = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint16_t *row_a = OSD_GRID_ROW(a, y);
+        const uint16_t *row_b = OSD_GRID_ROW(b, y);
+        uint8_t *dirty_row = dirty + y * OSD_GRID_STRIDE;
+        if (memcmp(row_a, row_b, width * sizeof(uint16_t)) == 0) {
+            // most rows don't change from one frame to the next
+            memset(dirty_row, 0, width);
+            continue;
+        }
+        for (uint32_t x = 0; x < width; x++) {
+            dirty_row[x] = row_a[x] != row_b[x];
+            changed += dirty_row[x];
+        }
+    }
+    return changed;
+}
+
+void osd_grid_set(osd_grid_t *grid, uint32_t x, uint32_t y, uint16_t c) {
+    if (x >= grid->width || y >= grid->height) {
+        return;
+    }
+    OSD_GRID_CELL(grid, x, y) = c;
+}
+
+void osd_grid_blit_row(osd_grid_t *grid, uint32_t x, uint32_t y, const uint8_t *string, uint16_t len, uint8_t page) {
+    // Write a run of characters from one font page along row y, clipped at the right edge.
+    if (x >= grid->width || y >= grid->height) {
+        return;
+    }
+    if (len > grid->width - x) {
+        len = grid->width - x;
+    }
+    uint16_t page_bits = (uint16_t)page << 8;
+    uint16_t *cell = &OSD_GRID_CELL(grid, x, y);
+    for (uint16_t i = 0; i < len; i++) {
+        cell[i] = string[i] | page_bits;
+    }
+}
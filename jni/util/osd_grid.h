@@ -0,0 +1,26 @@
+#include <stdint.h>
+
+// An OSD character grid, stored row-major so that walking along a row touches consecutive cells.
+// Rows are OSD_GRID_STRIDE cells apart whatever the width. Cells outside width x height are always 0,
+// so grids of different sizes can still be read and compared cell by cell.
+
+#define OSD_GRID_MAX_WIDTH 60
+#define OSD_GRID_MAX_HEIGHT 22
+#define OSD_GRID_STRIDE OSD_GRID_MAX_WIDTH
+
+typedef struct osd_grid_s {
+    uint8_t width;
+    uint8_t height;
+    uint16_t cells[OSD_GRID_MAX_HEIGHT * OSD_GRID_STRIDE];
+} osd_grid_t;
+
+#define OSD_GRID_ROW(grid, y) (&(grid)->cells[(y) * OSD_GRID_STRIDE])
+#define OSD_GRID_CELL(grid, x, y) ((grid)->cells[(y) * OSD_GRID_STRIDE + (x)])
+
+void osd_grid_init(osd_grid_t *grid, uint8_t width, uint8_t height);
+void osd_grid_clear(osd_grid_t *grid);
+void osd_grid_copy(osd_grid_t *dst, const osd_grid_t *src);
+uint8_t osd_grid_equal(const osd_grid_t *a, const osd_grid_t *b);
+uint32_t osd_grid_diff(const osd_grid_t *a, const osd_grid_t *b, uint8_t *dirty);
+void osd_grid_set(osd_grid_t *grid, uint32_t x, uint32_t y, uint16_t c);
+void osd_grid_blit_row(osd_grid_t *grid, uint32_t x, uint32_t y, const uint8_t *string, uint16_t len, uint8_t page);
@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "rle.h"
+
+uint32_t rle_encode(uint8_t *dst, uint32_t dst_size, const uint8_t *src, uint32_t len) {
+    // Returns the encoded size, or 0 if it would not fit in dst_size.
+    uint32_t out = 0;
+    uint32_t literal_start = 0;
+    uint32_t i = 0;
+    while (i <= len) {
+        uint32_t run = 1;
+        if (i < len) {
+            while (i + run < len && run < RLE_MAX_RUN && src[i + run] == src[i]) {
+                run++;
+            }
+        }
+        if (i == len || run >= RLE_MIN_RUN) {
+            // flush the literals that came before this run, in chunks of at most RLE_MAX_LITERALS
+            while (literal_start < i) {
+                uint32_t count = i - literal_start;
+                if (count > RLE_MAX_LITERALS) {
+                    count = RLE_MAX_LITERALS;
+                }
+                if (out + 1 + count > dst_size) {
+                    return 0;
+                }
+                dst[out++] = count - 1;
+                memcpy(&dst[out], &src[literal_start], count);
+                out += count;
+                literal_start += count;
+            }
+            if (i == len) {
+                break;
+            }
+            if (out + 2 > dst_size) {
+                return 0;
+            }
+            dst[out++] = 0x80 + run - RLE_MIN_RUN;
+            dst[out++] = src[i];
+            i += run;
+            literal_start = i;
+        } else {
+            i += run;
+        }
+    }
+    return out;
+}
+
+int32_t rle_decode(uint8_t *dst, uint32_t dst_size, const uint8_t *src, uint32_t len) {
+    // Returns the decoded size, or -1 if src is truncated or would overflow dst_size.
+    uint32_t out = 0;
+    uint32_t i = 0;
+    while (i < len) {
+        uint8_t control = src[i++];
+        if (control < 0x80) {
+            uint32_t count = control + 1;
+            if (i + count > len || out + count > dst_size) {
+                return -1;
+            }
+            memcpy(&dst[out], &src[i], count);
+            i += count;
+            out += count;
+        } else {
+            uint32_t count = control - 0x80 + RLE_MIN_RUN;
+            if (i >= len || out + count > dst_size) {
+                return -1;
+            }
+            memset(&dst[out], src[i++], count);
+            out += count;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,14 @@
+#include <stdint.h>
+
+// PackBits-style run length coding. A control byte below 0x80 is followed by control + 1 literal bytes,
+// one at or above 0x80 by a single byte to repeat control - 0x80 + RLE_MIN_RUN times.
+
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN (0x7F + RLE_MIN_RUN)
+#define RLE_MAX_LITERALS 0x80
+
+// worst case, nothing repeats and every RLE_MAX_LITERALS bytes cost a control byte
+#define RLE_MAX_ENCODED_SIZE(len) ((len) + ((len) + RLE_MAX_LITERALS - 1) / RLE_MAX_LITERALS)
+
+uint32_t rle_encode(uint8_t *dst, uint32_t dst_size, const uint8_t *src, uint32_t len);
+int32_t rle_decode(uint8_t *dst, uint32_t dst_size, const uint8_t *src, uint32_t len);